@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "bench.h"
+#include "output.h"
+#include "timer.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Minimum number of seconds to measure per record */
+/* So small patches are measured for about as long as big ones */
+#define BENCH_TIME 0.2
+
+
+/* Output file and whether a record was written to it yet */
+static FILE* benchFile = NULL;
+static int   benchComma = 0;
+
+/* Original stdout while quiet, negative if not quiet */
+static int benchStdout = -1;
+
+
+/*****************************/
+int open_bench(const char* file)
+{
+	benchFile = fopen(file, "w");
+	if(benchFile == NULL)
+	{
+		throw_error("Could not open file: %s", file);
+		return 0;
+	}
+
+	fputs("[", benchFile);
+	benchComma = 0;
+
+	return 1;
+}
+
+/*****************************/
+FILE* next_record(void)
+{
+	fputs(benchComma ? ",\n\t" : "\n\t", benchFile);
+	benchComma = 1;
+
+	return benchFile;
+}
+
+/*****************************/
+void close_bench(void)
+{
+	fputs("\n]\n", benchFile);
+	fclose(benchFile);
+	benchFile = NULL;
+}
+
+/*****************************/
+int run_bench(Bench* bench, BenchFunc func, void* arg)
+{
+	/* Always run at least one iteration, however long it takes */
+	unsigned int iterations = 0;
+	double t = 0;
+
+	while(t < BENCH_TIME || iterations == 0)
+	{
+		double it = func(arg);
+		if(it < 0)
+		{
+			quiet_bench(0);
+			throw_error("Benchmark %s of %u^2 failed.", bench->name, bench->size);
+			return 0;
+		}
+
+		t += it;
+		++iterations;
+	}
+
+	/* Bandwidth is nominal, what an iteration has to read and write at least */
+	double ns = t * 1e9 / (iterations * bench->vertices);
+	double gbs = bench->bytes * iterations / (t * 1e9);
+	double its = iterations / t;
+	const char* mode = bench->mode ? bench->mode : "";
+
+	output("%-18s %-10s %4u^2  %9.2f ns/vertex  %7.2f GB/s  %10.1f it/s",
+		bench->name, mode, bench->size, ns, gbs, its);
+
+	fprintf(next_record(),
+		"{ \"name\": \"%s\", \"mode\": \"%s\", \"size\": %u, \"iterations\": %u, "
+		"\"ns_per_vertex\": %.3f, \"gb_per_s\": %.3f, \"iterations_per_s\": %.3f }",
+		bench->name, mode, bench->size, iterations, ns, gbs, its);
+
+	return 1;
+}
+
+/*****************************/
+void quiet_bench(int quiet)
+{
+	/* Point stdout to /dev/null and back */
+	fflush(stdout);
+
+	if(quiet && benchStdout < 0)
+	{
+		int null = open("/dev/null", O_WRONLY);
+		if(null < 0)
+			return;
+
+		benchStdout = dup(STDOUT_FILENO);
+		dup2(null, STDOUT_FILENO);
+		close(null);
+	}
+
+	else if(!quiet && benchStdout >= 0)
+	{
+		dup2(benchStdout, STDOUT_FILENO);
+		close(benchStdout);
+		benchStdout = -1;
+	}
+}
+
+/*****************************/
+void copy_vertices(unsigned int size, Vertices* dst, Vertices* src)
+{
+	/* All planes are allocated in one block, so copy it in one go */
+	memcpy(dst->h, src->h, VERTEX_BYTES * size * size);
+}
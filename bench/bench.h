@@ -0,0 +1,98 @@
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "patch.h"
+#include <stdio.h>
+
+/* Benchmarked bytes of a vertex, all its planes */
+#define VERTEX_BYTES (sizeof(float) * 4 + sizeof(unsigned char))
+
+
+/* A single measurement, i.e. one record of the output */
+typedef struct
+{
+	const char*  name;     /* Name of what was measured */
+	const char*  mode;     /* Variant of it, can be NULL */
+	unsigned int size;     /* Width and height of the patch in vertices */
+	double       vertices; /* Vertices processed per iteration */
+	double       bytes;    /* Nominal bytes moved per iteration */
+
+} Bench;
+
+
+/**
+ * A single iteration of a benchmark, a function pointer.
+ * It times the part that is measured itself, so it can set up outside of it.
+ *
+ * @param  arg  Benchmark specific data.
+ * @return      Seconds the measured part took, negative on failure.
+ */
+typedef double (*BenchFunc)(void* arg);
+
+/**
+ * Opens the output file of all results.
+ *
+ * @return  Zero on failure.
+ */
+int open_bench(const char* file);
+
+/**
+ * Starts the next record in the output file.
+ *
+ * @return  The output file, to write a single JSON object to.
+ */
+FILE* next_record(void);
+
+/**
+ * Closes the output file, after which all results are valid JSON.
+ */
+void close_bench(void);
+
+/**
+ * Runs iterations of a benchmark until enough time was measured, then records it.
+ *
+ * @param  bench  Description of the measurement.
+ * @param  func   Function running a single iteration.
+ * @param  arg    Data to pass to func.
+ * @return        Zero if some iteration failed.
+ */
+int run_bench(Bench* bench, BenchFunc func, void* arg);
+
+/**
+ * Silences all output, useful for code that outputs as it goes.
+ *
+ * @param  quiet  Non-zero to silence, zero to restore output.
+ */
+void quiet_bench(int quiet);
+
+/**
+ * Copies all vertex data from src to dst, both of size * size vertices.
+ */
+void copy_vertices(unsigned int size, Vertices* dst, Vertices* src);
+
+/**
+ * Benchmarks of the iterative relaxation, see relax.c.
+ * The vertex data is the same subdivided terrain for all benchmarks of a size.
+ */
+int bench_relax(unsigned int size, Vertices* src);
+
+/**
+ * Flags the same paths as mod_subdivide, but as straight lines.
+ * So no paths have to be found, which takes minutes for big patches.
+ */
+void subdivide_straight(unsigned int size, Vertices* data);
+
+/**
+ * Benchmarks of the subdivision, see subdivide.c.
+ * Paths are only found for patches up to 1025^2.
+ */
+int bench_subdivide(unsigned int size, Vertices* src);
+
+/**
+ * Benchmarks of generation and all that reads a terrain, see patch.c.
+ */
+int bench_patch(unsigned int size, Vertices* src);
+
+
+#endif
@@ -0,0 +1,61 @@
+#include "bench.h"
+#include "generators.h"
+#include "output.h"
+#include "pool.h"
+#include <stdlib.h>
+
+/* Output file of the results */
+#define BENCH_FILE "bench_out.json"
+
+/* Range of sizes to measure, both 2^N+1 */
+#define BENCH_MIN_SIZE 33
+#define BENCH_MAX_SIZE 4097
+
+
+/*****************************/
+int main(int argc, char* argv[])
+{
+	/* Optional arguments are the smallest and largest size to measure */
+	/* e.g. bench 33 513, all sizes of the form 2^N+1 in between are measured */
+	unsigned int minSize = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_MIN_SIZE;
+	unsigned int maxSize = (argc > 2) ? strtoul(argv[2], NULL, 10) : BENCH_MAX_SIZE;
+
+	if(!open_bench(BENCH_FILE))
+		return EXIT_FAILURE;
+
+	int failed = 0;
+	unsigned int size;
+	for(size = 3; size <= maxSize && !failed; size = (size-1) * 2 + 1)
+	{
+		if(size < minSize)
+			continue;
+
+		/* Generate and subdivide the same terrain for every benchmark */
+		/* Paths are straight, so all sizes are subdivided alike and quickly */
+		Vertices src;
+		if(!create_vertices(&src, size))
+		{
+			throw_error("Failed to allocate memory for a %u^2 patch.", size);
+			failed = 1;
+			break;
+		}
+
+		srand(1);
+		failed = !gen_mpd(size, &src);
+		subdivide_straight(size, &src);
+
+		if(!failed)
+			failed =
+				!bench_relax(size, &src) ||
+				!bench_subdivide(size, &src) ||
+				!bench_patch(size, &src);
+
+		destroy_vertices(&src);
+	}
+
+	close_bench();
+	destroy_pool();
+	output("Results have been written to file: %s", BENCH_FILE);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "generators.h"
+#include "modifiers.h"
+#include "output.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Where output_terrain writes to, only formatting is of interest */
+#define BENCH_NULL "/dev/null"
+
+
+/* Any function of a whole terrain */
+typedef struct
+{
+	unsigned int size;
+	Vertices*    data;
+	ModData      mod;
+	Snapshot     snap;
+	float*       out;
+
+} PatchBench;
+
+
+/*****************************/
+static double run_gen_mpd(void* arg)
+{
+	PatchBench* b = arg;
+
+	double t = get_time();
+	int success = gen_mpd(b->size, b->data);
+	t = get_time() - t;
+
+	return success ? t : -1;
+}
+
+/*****************************/
+static double run_output(void* arg)
+{
+	/* Through mod_output, it is output_terrain with the heights */
+	PatchBench* b = arg;
+	quiet_bench(1);
+
+	double t = get_time();
+	int success = mod_output(b->size, b->data, &b->mod);
+	t = get_time() - t;
+
+	quiet_bench(0);
+	return success ? t : -1;
+}
+
+/*****************************/
+static double run_stats(void* arg)
+{
+	PatchBench* b = arg;
+	quiet_bench(1);
+
+	double t = get_time();
+	int success = mod_stats(b->size, b->data, &b->mod);
+	t = get_time() - t;
+
+	quiet_bench(0);
+	return success ? t : -1;
+}
+
+/*****************************/
+static double run_mesh(void* arg)
+{
+	PatchBench* b = arg;
+
+	double t = get_time();
+	build_snapshot_vertices(b->size, &b->snap, b->out);
+
+	return get_time() - t;
+}
+
+/*****************************/
+int bench_patch(unsigned int size, Vertices* src)
+{
+	PatchBench b;
+	memset(&b, 0, sizeof(PatchBench));
+	b.size = size;
+	b.data = src;
+	b.mod.out = BENCH_NULL;
+	b.snap.h = src->h;
+	b.snap.flags = src->flags;
+
+	/* Generation writes to a terrain of its own, src is left alone */
+	Vertices gen;
+	b.out = malloc(sizeof(float) * size * size * 9);
+
+	if(b.out == NULL || !create_vertices(&gen, size))
+	{
+		throw_error("Failed to allocate memory for a %u^2 patch.", size);
+		free(b.out);
+		return 0;
+	}
+
+	double n = (double)size * size;
+	PatchBench g = b;
+	g.data = &gen;
+
+	Bench mpd = {
+		.name = "gen_mpd", .size = size, .vertices = n,
+		.bytes = n * sizeof(float)
+	};
+
+	Bench output = {
+		.name = "output_terrain", .size = size, .vertices = n,
+		.bytes = n * sizeof(float)
+	};
+
+	Bench stats = {
+		.name = "mod_stats", .size = size, .vertices = n,
+		.bytes = n * VERTEX_BYTES
+	};
+
+	/* Reads heights and flags, writes position, normal and color */
+	Bench mesh = {
+		.name = "upload_mesh", .mode = "cpu", .size = size, .vertices = n,
+		.bytes = n * (sizeof(float) * 10 + sizeof(unsigned char))
+	};
+
+	int success =
+		run_bench(&mpd, run_gen_mpd, &g) &&
+		run_bench(&output, run_output, &b) &&
+		run_bench(&stats, run_stats, &b) &&
+		run_bench(&mesh, run_mesh, &b);
+
+	free(b.out);
+	destroy_vertices(&gen);
+
+	return success;
+}
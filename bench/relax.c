@@ -0,0 +1,207 @@
+#include "bench.h"
+#include "constants.h"
+#include "modifiers.h"
+#include "output.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* A relaxation modifier, restarted whenever it converges */
+typedef struct
+{
+	unsigned int size;
+	Vertices*    src;
+	Vertices     data;
+	ModData      mod;
+
+} RelaxBench;
+
+
+/* A single constraint type on all interior vertices */
+/* Its heights never change, so every iteration does the same work */
+typedef struct
+{
+	unsigned int size;
+	Vertices     data;
+	float*       out;
+	int          simd;
+
+} KernelBench;
+
+
+/*****************************/
+static int start_relax(RelaxBench* b)
+{
+	/* Run one step first, so buffers are allocated and the caches are warm */
+	free(b->mod.buffer);
+	free(b->mod.work);
+
+	ModMode mode = b->mod.mode;
+	memset(&b->mod, 0, sizeof(ModData));
+	b->mod.mode = mode;
+	b->mod.steps = 1;
+
+	copy_vertices(b->size, &b->data, b->src);
+	return mod_relax(b->size, &b->data, &b->mod);
+}
+
+/*****************************/
+static double run_relax(void* arg)
+{
+	/* It outputs when it converges, which is not of interest */
+	RelaxBench* b = arg;
+	quiet_bench(1);
+
+	if(b->mod.done && !start_relax(b))
+	{
+		quiet_bench(0);
+		return -1;
+	}
+
+	double t = get_time();
+	int success = mod_relax(b->size, &b->data, &b->mod);
+	t = get_time() - t;
+
+	quiet_bench(0);
+	return success ? t : -1;
+}
+
+/*****************************/
+static double run_kernel(void* arg)
+{
+	KernelBench* b = arg;
+	unsigned int size = b->size;
+	float scale = GET_SCALE(size);
+
+	double t = get_time();
+	unsigned int c, r;
+
+	if(b->simd)
+		for(c = 1; c < size-1; ++c)
+			relax_column_simd(size, c, scale, 1.0f, &b->data, b->data.h, b->out, &r);
+	else
+		for(c = 1; c < size-1; ++c)
+			for(r = 1; r < size-1; ++r)
+				relax_vertex(size, c * size + r, scale, 1.0f, &b->data, b->data.h, b->out);
+
+	return get_time() - t;
+}
+
+/*****************************/
+static int bench_kernel(
+	KernelBench* b,
+	Vertices*    src,
+	const char*  name,
+	VertexFlag   flag,
+	unsigned int params)
+{
+	/* Constrain the interior as tightly as the subdivision does */
+	/* Roughness asks for half of what is there */
+	unsigned int size = b->size;
+	float scale = GET_SCALE(size);
+
+	copy_vertices(size, &b->data, src);
+	memcpy(b->out, src->h, sizeof(float) * size * size);
+
+	unsigned int c, r;
+	for(c = 1; c < size-1; ++c)
+		for(r = 1; r < size-1; ++r)
+		{
+			unsigned int i = c * size + r;
+			b->data.flags[i] = flag;
+			b->data.c[0][i] = (flag == ROUGHNESS) ?
+				.5f * calc_roughness(size, src->h, i, scale) : MAX_SLOPE;
+			b->data.c[1][i] = 0.0f;
+		}
+
+	/* Reads flags, parameters and heights, reads and writes corrections */
+	Bench bench = {
+		.name = name,
+		.mode = "scalar",
+		.size = size,
+		.vertices = (double)(size-2) * (size-2),
+		.bytes = (double)(size-2) * (size-2) *
+			(sizeof(unsigned char) + sizeof(float) * (params + 3))
+	};
+
+	b->simd = 0;
+	if(!run_bench(&bench, run_kernel, b))
+		return 0;
+
+	/* The vectorized version, if any */
+	unsigned int rows;
+	relax_column_simd(size, 1, scale, 1.0f, &b->data, b->data.h, b->out, &rows);
+	if(flag == ROUGHNESS || rows == 0)
+		return 1;
+
+	bench.mode = "simd";
+	b->simd = 1;
+
+	return run_bench(&bench, run_kernel, b);
+}
+
+/*****************************/
+int bench_relax(unsigned int size, Vertices* src)
+{
+	/* Whole sweeps in all modes, each iteration is exactly one sweep */
+	/* As steps stays at 1, and converging starts over outside of the measurement */
+	ModMode modes[] = { SEQUENTIAL, PARALLEL };
+	const char* names[] = { "sequential", "parallel" };
+
+	RelaxBench rb;
+	memset(&rb, 0, sizeof(RelaxBench));
+	rb.size = size;
+	rb.src = src;
+
+	if(!create_vertices(&rb.data, size))
+	{
+		throw_error("Failed to allocate memory for a %u^2 patch.", size);
+		return 0;
+	}
+
+	int success = 1;
+	unsigned int m;
+	for(m = 0; m < sizeof(modes) / sizeof(ModMode) && success; ++m)
+	{
+		Bench bench = {
+			.name = "mod_relax",
+			.mode = names[m],
+			.size = size,
+			.vertices = (double)size * size,
+			.bytes = (double)size * size * VERTEX_BYTES
+		};
+
+		rb.mod.mode = modes[m];
+		rb.mod.done = 1;
+		success = run_bench(&bench, run_relax, &rb);
+	}
+
+	free(rb.mod.buffer);
+	free(rb.mod.work);
+	destroy_vertices(&rb.data);
+
+	if(!success)
+		return 0;
+
+	/* Each constraint kernel in isolation */
+	KernelBench kb;
+	kb.size = size;
+	kb.out = malloc(sizeof(float) * size * size);
+
+	if(kb.out == NULL || !create_vertices(&kb.data, size))
+	{
+		throw_error("Failed to allocate memory for a %u^2 patch.", size);
+		free(kb.out);
+		return 0;
+	}
+
+	success =
+		bench_kernel(&kb, src, "relax_slope", SLOPE, 1) &&
+		bench_kernel(&kb, src, "relax_dir_slope", DIR_SLOPE, 2) &&
+		bench_kernel(&kb, src, "relax_roughness", ROUGHNESS, 1);
+
+	free(kb.out);
+	destroy_vertices(&kb.data);
+
+	return success;
+}
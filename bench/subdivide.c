@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "timer.h"
+#include <string.h>
+
+/* The path finding is internal to the subdivision, so include it whole */
+/* This binary doesn't link its object file for that reason */
+#include "../src/modifiers/subdivide.c"
+
+/* Largest size to find a path at, A* takes minutes per path beyond */
+#define BENCH_PATH_SIZE 1025
+
+/* Number of ellipses to flag per iteration */
+#define BENCH_ELLIPSES 16
+
+
+/* Either a path or ellipses along a diagonal, on an unflagged terrain */
+typedef struct
+{
+	unsigned int size;
+	Vertices*    src;
+	Vertices     data;
+
+} SubdivideBench;
+
+
+/*****************************/
+static void clear_flags(SubdivideBench* b)
+{
+	/* Already flagged vertices are skipped, so start without any every time */
+	copy_vertices(b->size, &b->data, b->src);
+	memset(b->data.flags, 0, sizeof(unsigned char) * b->size * b->size);
+}
+
+/*****************************/
+static double run_find_path(void* arg)
+{
+	/* The first path mod_subdivide finds */
+	SubdivideBench* b = arg;
+	unsigned int size = b->size;
+	clear_flags(b);
+
+	ANode bot = { .c = size * .6f, .r = size * .1f };
+	ANode le = { .c = size * .2f, .r = size * .5f };
+
+	double t = get_time();
+	int success = find_path(size, &b->data, bot, le);
+	t = get_time() - t;
+
+	return success ? t : -1;
+}
+
+/*****************************/
+static double run_flag_ellipse(void* arg)
+{
+	/* Flag ellipses along the diagonal, like find_path does along a path */
+	/* Spaced so they don't overlap much at any size */
+	SubdivideBench* b = arg;
+	unsigned int size = b->size;
+	float scale = GET_SCALE(size);
+	float r = PATH_RADIUS / scale;
+	clear_flags(b);
+
+	double t = get_time();
+	unsigned int e;
+	for(e = 0; e < BENCH_ELLIPSES; ++e)
+	{
+		unsigned int d = (size-1) * e / (BENCH_ELLIPSES-1);
+		ANode n = { .c = d, .r = d };
+		flag_ellipse(size, &b->data, n, r, r, PATH_INFLUENCE / scale);
+	}
+
+	return get_time() - t;
+}
+
+/*****************************/
+void subdivide_straight(unsigned int size, Vertices* data)
+{
+	/* The same nodes as mod_subdivide */
+	float scale = GET_SCALE(size);
+	float r = PATH_RADIUS / scale;
+	float b = PATH_INFLUENCE / scale;
+
+	ANode nodes[4] = {
+		{ .c = size * .6f, .r = size * .1f },
+		{ .c = size * .2f, .r = size * .5f },
+		{ .c = size * .8f, .r = size * .3f },
+		{ .c = size * .6f, .r = size * .9f }
+	};
+
+	flag_ellipse(size, data, nodes[0], r, r, b);
+	flag_ellipse(size, data, nodes[3], r, r, b);
+	flag_ellipse(size, data, nodes[1], r * 3.0f, r * 2.5f, b);
+	flag_ellipse(size, data, nodes[2], r * 2.8f, r * 2.0f, b);
+
+	/* Connect them in the same order, but in a straight line */
+	/* Step by the path radius, the ellipses overlap plenty */
+	unsigned int edges[4][2] = { { 0, 1 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+	unsigned int e, s;
+	for(e = 0; e < 4; ++e)
+	{
+		ANode u = nodes[edges[e][0]];
+		ANode v = nodes[edges[e][1]];
+		unsigned int steps = (unsigned int)(D(u, v) / fmaxf(r, 1.0f)) + 1;
+
+		for(s = 0; s <= steps; ++s)
+		{
+			float f = (float)s / steps;
+			ANode n = {
+				.c = u.c + f * ((float)v.c - (float)u.c) + .5f,
+				.r = u.r + f * ((float)v.r - (float)u.r) + .5f
+			};
+			flag_ellipse(size, data, n, r, r, b);
+		}
+	}
+}
+
+/*****************************/
+int bench_subdivide(unsigned int size, Vertices* src)
+{
+	SubdivideBench b;
+	b.size = size;
+	b.src = src;
+
+	if(!create_vertices(&b.data, size))
+	{
+		throw_error("Failed to allocate memory for a %u^2 patch.", size);
+		return 0;
+	}
+
+	/* A* initializes and may visit every node, reading heights */
+	Bench path = {
+		.name = "find_path",
+		.size = size,
+		.vertices = (double)size * size,
+		.bytes = (double)size * size * (sizeof(float) + sizeof(ANodeData) + sizeof(ANode))
+	};
+
+	/* Each ellipse visits its bounding box, writing flags and constraints */
+	float scale = GET_SCALE(size);
+	float rb = (PATH_RADIUS + (USE_DIR_SLOPE ? PATH_INFLUENCE : 0)) / scale;
+	double box = (2 * (int)rb + 1) * (double)(2 * (int)rb + 1);
+
+	Bench ellipse = {
+		.name = "flag_ellipse",
+		.size = size,
+		.vertices = box * BENCH_ELLIPSES,
+		.bytes = box * BENCH_ELLIPSES * (sizeof(unsigned char) + sizeof(float) * 2)
+	};
+
+	int success =
+		(size > BENCH_PATH_SIZE || run_bench(&path, run_find_path, &b)) &&
+		run_bench(&ellipse, run_flag_ellipse, &b);
+
+	destroy_vertices(&b.data);
+
+	return success;
+}
@@ -0,0 +1,288 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "bench.h"
+#include "generators.h"
+#include "modifiers.h"
+#include "output.h"
+#include "pool.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Output file of the results */
+#define BENCH_FILE "bench_throughput.json"
+
+/* Maximum number of sizes to run in one go */
+#define MAX_SIZES 16
+
+/* Milliseconds between checking on the terrains */
+#define BENCH_POLL 0.1
+
+/* The modifier chain of a scene, minus the terrain outputs */
+#define NUM_MODS 4
+
+static const char* names[NUM_MODS] = {
+	"subdivide",
+	"stats_l",
+	"relax",
+	"stats_h"
+};
+
+
+/* A single terrain in progress */
+typedef struct
+{
+	Patch patch;
+	int   running;
+
+} Terrain;
+
+
+/* Totals of all terrains of a run */
+typedef struct
+{
+	unsigned int terrains;
+	unsigned int iterations;
+	double       wall;
+	double       generate;
+	double       mods[NUM_MODS];
+
+} Totals;
+
+
+/*****************************/
+static int start_terrain(
+	Terrain*     t,
+	Totals*      totals,
+	unsigned int size,
+	unsigned int seed,
+	ModMode      mode,
+	Accel        accel)
+{
+	PatchModifier mods[NUM_MODS + 1] = {
+		mod_subdivide,
+		mod_stats,
+		mode == MULTIGRID ? mod_relax_multigrid : mod_relax,
+		mod_stats,
+		NULL
+	};
+
+	if(!create_patch(&t->patch, mode, accel, size))
+		return 0;
+
+	/* Generation is done on this thread, the modifiers in the background */
+	double start = get_time();
+	srand(seed);
+
+	if(!populate_patch(&t->patch, gen_mpd, mods, NULL, NULL))
+	{
+		destroy_patch(&t->patch);
+		return 0;
+	}
+
+	totals->generate += get_time() - start;
+	t->running = 1;
+
+	return 1;
+}
+
+/*****************************/
+static void finish_terrain(Terrain* t, Totals* totals)
+{
+	/* The worker is done, so its modifiers can be read */
+	size_t m;
+	for(m = 0; m < t->patch.num_mods && m < NUM_MODS; ++m)
+	{
+		totals->mods[m] += t->patch.mods[m].time;
+		totals->iterations += t->patch.mods[m].iterations;
+	}
+
+	++totals->terrains;
+	destroy_patch(&t->patch);
+	t->running = 0;
+}
+
+/*****************************/
+static int run_terrains(
+	Totals*      totals,
+	unsigned int size,
+	ModMode      mode,
+	Accel        accel,
+	unsigned int first,
+	unsigned int last,
+	unsigned int jobs)
+{
+	/* Keep jobs terrains running at all times, until all seeds are done */
+	Terrain* terrains = calloc(jobs, sizeof(Terrain));
+	if(terrains == NULL)
+	{
+		throw_error("Failed to allocate memory for terrains.");
+		return 0;
+	}
+
+	memset(totals, 0, sizeof(Totals));
+	unsigned int count = last - first + 1;
+	unsigned int next = 0;
+	unsigned int finished = 0;
+	int failed = 0;
+
+	double start = get_time();
+
+	while(finished < count)
+	{
+		unsigned int j;
+		for(j = 0; j < jobs; ++j)
+		{
+			Terrain* t = terrains + j;
+
+			if(!t->running && next < count)
+			{
+				if(!start_terrain(t, totals, size, first + next++, mode, accel))
+				{
+					failed = 1;
+					++finished;
+				}
+			}
+
+			else if(t->running)
+			{
+				failed |= !update_patch(&t->patch, NULL);
+				if(is_patch_done(&t->patch))
+				{
+					finish_terrain(t, totals);
+					++finished;
+				}
+			}
+		}
+
+		struct timespec ts = { .tv_sec = 0, .tv_nsec = BENCH_POLL * 1000000 };
+		nanosleep(&ts, NULL);
+	}
+
+	totals->wall = get_time() - start;
+	free(terrains);
+
+	return !failed;
+}
+
+/*****************************/
+static void record_totals(
+	Totals*      totals,
+	unsigned int size,
+	const char*  mode,
+	unsigned int jobs)
+{
+	/* Peak resident memory of the whole process so far, in kilobytes on Linux */
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	/* Jobs beyond the number of processors don't add any cores */
+	unsigned int cores = pool_threads();
+	cores = (jobs < cores) ? jobs : cores;
+
+	double tps = totals->terrains / totals->wall;
+
+	output("%4u^2 %-6s %2u jobs  %8.2f terrains/s  %8.2f per core  %9u iterations  %8ld KB",
+		size, mode, jobs, tps, tps / cores, totals->iterations, usage.ru_maxrss);
+
+	output("       generate %.3fs, %s %.3fs, %s %.3fs, %s %.3fs, %s %.3fs",
+		totals->generate,
+		names[0], totals->mods[0], names[1], totals->mods[1],
+		names[2], totals->mods[2], names[3], totals->mods[3]);
+
+	/* Modifier times are summed over all terrains, so can exceed the wall time */
+	FILE* f = next_record();
+	fprintf(f,
+		"{ \"size\": %u, \"mode\": \"%s\", \"jobs\": %u, \"terrains\": %u, "
+		"\"wall_s\": %.4f, \"terrains_per_s\": %.4f, \"terrains_per_s_per_core\": %.4f, "
+		"\"iterations\": %u, \"peak_rss_kb\": %ld, \"time_s\": { \"generate\": %.4f",
+		size, mode, jobs, totals->terrains,
+		totals->wall, tps, tps / cores,
+		totals->iterations, usage.ru_maxrss, totals->generate);
+
+	unsigned int m;
+	for(m = 0; m < NUM_MODS; ++m)
+		fprintf(f, ", \"%s\": %.4f", names[m], totals->mods[m]);
+
+	fputs(" } }", f);
+}
+
+/*****************************/
+int main(int argc, char* argv[])
+{
+	/* Input is similar to terr_batch, all arguments are optional */
+	/* - First argument is a comma separated list of grid sizes, default 65,129 */
+	/* - Second argument determines the mode, as for terr, default s */
+	/* - Third argument is a range of seeds, default 1-16 */
+	/* - Fourth argument is the number of terrains to run at once */
+	/*   A range, e.g. 1-4, runs all seeds at each number to show scaling */
+	/*   The default is a range up to one per processor */
+	unsigned int sizes[MAX_SIZES] = { 65, 129 };
+	unsigned int numSizes = 2;
+
+	char* str = (argc > 1) ? argv[1] : "";
+	if(*str != '\0')
+		numSizes = 0;
+
+	while(*str != '\0' && numSizes < MAX_SIZES)
+	{
+		sizes[numSizes] = strtoul(str, &str, 10);
+		if(sizes[numSizes] >= 2)
+			++numSizes;
+		if(*str == ',')
+			++str;
+		else
+			break;
+	}
+
+	const char* modeStr = (argc > 2) ? argv[2] : "s";
+	ModMode mode = SEQUENTIAL;
+	Accel accel;
+	read_mode(modeStr, &mode, &accel);
+
+	unsigned int first = 1, last = 16;
+	if(argc > 3)
+	{
+		first = strtoul(argv[3], &str, 10);
+		last = (*str == '-') ? strtoul(str + 1, NULL, 10) : first;
+	}
+
+	unsigned int minJobs = 1, maxJobs = pool_threads();
+	if(argc > 4)
+	{
+		minJobs = strtoul(argv[4], &str, 10);
+		maxJobs = (*str == '-') ? strtoul(str + 1, NULL, 10) : minJobs;
+	}
+
+	if(numSizes == 0 || first < 1 || last < first || minJobs < 1 || maxJobs < minJobs)
+	{
+		throw_error("Usage: bench_throughput <resolutions> <mode> <seeds> <jobs>");
+		return EXIT_FAILURE;
+	}
+
+	if(!open_bench(BENCH_FILE))
+		return EXIT_FAILURE;
+
+	int failed = 0;
+	unsigned int s, j;
+	for(s = 0; s < numSizes && !failed; ++s)
+		for(j = minJobs; j <= maxJobs && !failed; ++j)
+		{
+			/* Everything the terrains output is of no interest */
+			Totals totals;
+			quiet_bench(1);
+			failed = !run_terrains(&totals, sizes[s], mode, accel, first, last, j);
+			quiet_bench(0);
+
+			if(!failed)
+				record_totals(&totals, sizes[s], modeStr, j);
+		}
+
+	close_bench();
+	destroy_pool();
+	output("Results have been written to file: %s", BENCH_FILE);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@
 #define OUT_FILE_ITERS    "iter_out.txt"
 #define OUT_FILE_STATS_L  "stats_out_l.txt"
 #define OUT_FILE_STATS_H  "stats_out_h.txt"
+#define OUT_FILE_TRACE    "trace_out.json"
 #define IN_FILE_H_OPT     "terrain_out_h_opt.json"
 
 
@@ -42,12 +43,27 @@
 /* USE_BORDER_STITCH indicates to set position constraints at patch borders */
 /* USE_BORDER_DERIV extends the patch borders with derivative constraints (more position constraints) */
 /* When AUTO_SURROUND is non-zero, any patch will first be surrounded by 4 unconstrained patches */
+/* USE_SIMD indicates to use SIMD kernels for the slope constraints of parallel sweeps */
+/*   They round differently from the scalar path, and from each other per instruction set */
+/*   So parallel relaxation is then only reproducible on CPUs with the same instruction set */
+/* USE_TRACE records scoped timers of the hot paths, written to OUT_FILE_TRACE on exit */
+/* USE_PERF_COUNTERS adds hardware counters of the solver phases to the stats output */
 #define USE_DIR_SLOPE      1
 #define USE_ROUGHNESS      0
 #define USE_BORDER_STITCH  1
 #define USE_BORDER_DERIV   0
 #define AUTO_SURROUND      0
 
+#ifndef USE_SIMD
+	#define USE_SIMD           0
+#endif
+#ifndef USE_TRACE
+	#define USE_TRACE          0
+#endif
+#ifndef USE_PERF_COUNTERS
+	#define USE_PERF_COUNTERS  0
+#endif
+
 /* Hardcoded path parameters for now */
 /* The falloff is the ascend in the maximum slope the farther you get from the path boundary */
 /* The influence is the distance from the path that the gradient constraint holds */
@@ -65,8 +81,58 @@
 #define S_THRESHOLD     0.00001f /* Convergence threshold of slope error */
 #define R_THRESHOLD     0.04f /* Convergence threshold of roughness error */
 #define MAX_ITERATIONS  100000
-#define STEP_SIZE       10
+#define STEP_SIZE       10 /* Iterations per modifier call if not scheduled */
 #define ITER_PRINT      1000
 
+/* Time a patch's worker spends on running modifiers before publishing a snapshot, in milliseconds */
+/* Iterative modifiers run as many iterations as fit, estimated from their past calls */
+/* But never more than MAX_STEP_SIZE per call, so a bad estimate can't delay a snapshot for long */
+#define MOD_BUDGET      8
+#define MAX_STEP_SIZE   10000
+
+/* Default parameters of accelerated relaxation */
+/* SOR_OMEGA is the over-relaxation factor, in (1,2) */
+/* Chebyshev estimates the spectral radius of a parallel sweep from CHEB_WARMUP plain ones */
+/* It starts over when the number of vertices a sweep moves changes by a fraction CHEB_RESTART */
+/* The estimate is capped at CHEB_RHO_MAX (< 1) */
+#define SOR_OMEGA     1.5f
+#define CHEB_WARMUP   8
+#define CHEB_RESTART  0.5
+#define CHEB_RHO_MAX  0.9999f
+
+/* A parallel sweep splits the columns into strips of about STRIP_COLUMNS (>= 2) each */
+/* The strips fix the order of all updates, so it must not depend on the number of threads */
+/* That way results are bit-identical no matter how many threads there are */
+#define STRIP_COLUMNS  8
+
+/* Multigrid levels get coarser until they would be smaller than MG_MIN_SIZE */
+/* Each level is smoothed MG_SMOOTH times before and after visiting a coarser level */
+/* The coarsest level is relaxed up to MG_COARSE_ITERATIONS times */
+#define MG_MIN_SIZE           17
+#define MG_SMOOTH             48
+#define MG_COARSE_ITERATIONS  100
+
+/* The direct 1D slope solver also runs the iterative one when SLOPE_1D_COMPARE is non-zero */
+/* It then outputs how far apart their results are, but that runs all the (slow) iterations again */
+#ifndef SLOPE_1D_COMPARE
+	#define SLOPE_1D_COMPARE  0
+#endif
+
+/* Default tolerances of terr_verify, comparing a candidate solver to a reference */
+/* VERIFY_HEIGHT is the largest height difference of any vertex */
+/* It is meant for variants of the same sweep, e.g. vectorized or reordered */
+/* Different sweeps converge to different solutions, they need a far larger one */
+/* VERIFY_SUPPLIES is the largest relative difference of the total supplies */
+/* VERIFY_MOVED is how much more material (mean height change) the candidate may move, relatively */
+/* That stands in for the EMD, any sweep should end up about as close to its input */
+#define VERIFY_HEIGHT    0.001f
+#define VERIFY_SUPPLIES  0.0001f
+#define VERIFY_MOVED     0.1f
+
+
+/*****************************/
+/* Number of threads to use for parallel work, 0 means one per processor */
+#define NUM_THREADS  0
+
 
 #endif
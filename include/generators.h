@@ -7,18 +7,18 @@
 /**
  * Generates a white noise pattern.
  */
-int gen_white_noise(unsigned int size, Vertex* data);
+int gen_white_noise(unsigned int size, Vertices* data);
 
 /**
  * Generates smth using the diamond-square midpoint displacement algorithm.
  * Note: size must be of the form 2^N+1.
  */
-int gen_mpd(unsigned int size, Vertex* data);
+int gen_mpd(unsigned int size, Vertices* data);
 
 /**
  * Generator that reads terrain from file.
  */
-int gen_file(unsigned int size, Vertex* data);
+int gen_file(unsigned int size, Vertices* data);
 
 
 #endif
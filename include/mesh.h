@@ -0,0 +1,57 @@
+
+#ifndef MESH_H
+#define MESH_H
+
+#include "deps.h"
+#include "patch.h"
+
+/* Mesh definition, the GPU side of a patch */
+typedef struct
+{
+	unsigned int size; /* Width and height in vertices (always a square) */
+
+	GLuint       vao;
+	GLuint       vertices;
+	GLuint       indices;
+
+} Mesh;
+
+
+/**
+ * Creates a new mesh of some specified size.
+ *
+ * @param  size  Width and height of the mesh in vertices.
+ * @return       Zero if creation failed.
+ */
+int create_mesh(Mesh* mesh, unsigned int size);
+
+/**
+ * Destroys a mesh.
+ */
+void destroy_mesh(Mesh* mesh);
+
+/**
+ * Uploads vertex data to a mesh, computing the normals and colors.
+ *
+ * @param  snap  Snapshot of the vertex data, must be of the same size as the mesh.
+ * @return       Zero if uploading failed.
+ */
+int upload_mesh(Mesh* mesh, Snapshot* snap);
+
+/**
+ * Uploads vertex data that was already built, see build_snapshot_vertices.
+ * So it can be built on any thread, only this has to be on the GL thread.
+ *
+ * @param  data  Vertex data of the same size as the mesh.
+ */
+void upload_mesh_vertices(Mesh* mesh, const float* data);
+
+/**
+ * Draws a mesh.
+ *
+ * Note: Assumes some shader program is bound and set up.
+ */
+void draw_mesh(Mesh* mesh);
+
+
+#endif
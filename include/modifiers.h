@@ -4,6 +4,77 @@
 
 #include "patch.h"
 
+
+/* Constraints of a single type, compiled into flat arrays */
+/* Entries are column-major, like vertices, the entries of column c are in [offsets[c], offsets[c+1]) */
+typedef struct
+{
+	unsigned int* offsets; /* size+1 offsets into the other arrays */
+	unsigned int* ix;      /* Vertex index of each entry */
+	float*        p[3];    /* Parameters of each entry, depending on the type */
+
+} ConstraintList;
+
+
+/* All constraints of a patch, compiled into a list per type */
+typedef struct
+{
+	ConstraintList slope;     /* p[0] = maximum slope */
+	ConstraintList dir_slope; /* p[0], p[1] = normalized direction, p[2] = maximum slope */
+	ConstraintList roughness; /* p[0] = roughness */
+	ConstraintList position;  /* p[0] = height */
+
+} Constraints;
+
+
+/* Statistics of a single constraint type */
+typedef struct
+{
+	unsigned int count;
+	unsigned int satisfied;
+	unsigned int unsatisfied;
+	float        distance; /* Average distance from goal */
+
+} ConstraintStats;
+
+
+/* Statistics of a terrain, everything mod_stats outputs */
+typedef struct
+{
+	float           supplies;     /* Total supplies, i.e. the sum of all heights */
+	float           max_slope_1d; /* Maximum slope along either axis, of slope constrained vertices */
+	float           max_slope;    /* Maximum gradient magnitude, of slope constrained vertices */
+	ConstraintStats slope;
+	ConstraintStats dir_slope;
+	ConstraintStats roughness;
+	ConstraintStats position;
+
+} Stats;
+
+
+/**
+ * Compiles the flags and constraint values of a patch into a list per constraint type.
+ * Unconstrained vertices do not appear in any list.
+ *
+ * @param  size  Width and height of the patch data in vertices.
+ * @param  data  Vertex data of size * size vertices (column-major).
+ * @return       The compiled constraints, NULL on failure, must be freed with free().
+ *
+ * Note: the constraints are copied, so they must be compiled again if the flags change.
+ */
+Constraints* create_constraints(unsigned int size, Vertices* data);
+
+/**
+ * Makes each connected region of slope constraints (and nothing else) satisfy them in one go.
+ * The region is replaced by halfway its lower and upper Lipschitz envelopes.
+ * Then shifted so it holds as much material as before, only its border is left unsatisfied.
+ *
+ * @param  size  Width and height of the patch data in vertices.
+ * @param  data  Vertex data of size * size vertices (column-major).
+ * @return       Zero on failure.
+ */
+int envelope_slopes(unsigned int size, Vertices* data);
+
 /**
  * Returns the indices of a point its two neighbors for calculations based on gradient.
  *
@@ -24,41 +95,105 @@ int get_neighbours(
  * Calculates the roughness of the terrain at a given position.
  *
  * @param  size   Width and height of the patch data in vertices.
- * @param  data   Data array of size * size length (column-major).
+ * @param  h      Heights of size * size vertices (column-major).
  * @param  ix     Position we want the roughness of.
  * @param  scale  Scale of the terrain.
  */
 float calc_roughness(
 	unsigned int size,
-	Vertex*      data,
+	float*       h,
 	unsigned int ix,
 	float        scale);
 
+/**
+ * Relaxes all constraints of a single vertex, once.
+ *
+ * @param  size    Width and height of the patch data in vertices.
+ * @param  ix      Index of the vertex to relax.
+ * @param  scale   Scale of the terrain.
+ * @param  weight  Fraction of each correction to apply.
+ * @param  data    Data to read constraints and flags from.
+ * @param  inp     Heights to read from.
+ * @param  out     Heights to apply the corrections to, can be equal to inp.
+ * @return         Non-zero if all constraints were already satisfied.
+ */
+int relax_vertex(
+	unsigned int size,
+	unsigned int ix,
+	float        scale,
+	float        weight,
+	Vertices*    data,
+	float*       inp,
+	float*       out);
+
+/**
+ * Relaxes the slope and directional slope constraints of a column once, multiple rows at a time.
+ * Only whole vectors of interior rows are relaxed, starting at row 1.
+ * The widest SIMD instruction set the CPU supports is picked at runtime.
+ *
+ * @param  c     Column to relax, must not be the first or last column.
+ * @param  inp   Heights to read from.
+ * @param  out   Heights to apply the corrections to, must not be equal to inp.
+ * @param  rows  Outputs the number of rows that were relaxed, zero if no SIMD is supported.
+ * @return       Non-zero if all constraints were already satisfied.
+ *
+ * Note: rows are relaxed in [1, rows], all others are left to relax_vertex.
+ * Roughness constraints are always left to relax_vertex.
+ * The result is not bit-identical to relax_vertex, nor across instruction sets.
+ * Corrections are summed in a different order and slopes are rounded differently.
+ */
+int relax_column_simd(
+	unsigned int  size,
+	unsigned int  c,
+	float         scale,
+	float         weight,
+	Vertices*     data,
+	float*        inp,
+	float*        out,
+	unsigned int* rows);
+
+/**
+ * Marks an iterative relaxation modifier as done.
+ * Frees its buffers and appends its number of iterations to its output file.
+ *
+ * @param  done  Non-zero if it converged, zero if it ran out of iterations.
+ */
+void finish_relax(ModData* mod, int done);
+
+/**
+ * Calculates the statistics of a terrain.
+ *
+ * @param  size   Width and height of the patch data in vertices.
+ * @param  data   Vertex data of size * size vertices (column-major).
+ * @param  stats  Output statistics.
+ */
+void calc_stats(unsigned int size, Vertices* data, Stats* stats);
+
 /**
  * Simply outputs some statistics about the terrain.
  */
-int mod_stats(unsigned int size, Vertex* data, ModData* mod);
+int mod_stats(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Outputs the terrain to an output .json file.
  */
-int mod_output(unsigned int size, Vertex* data, ModData* mod);
+int mod_output(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Outputs the terrain's flags to an output .json file.
  */
-int mod_output_flags(unsigned int size, Vertex* data, ModData* mod);
+int mod_output_flags(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Outputs the constraint values to an output .json file.
  */
-int mod_output_constrs(unsigned int size, Vertex* data, ModData* mod);
+int mod_output_constrs(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Makes a subdivision of the terrain.
  * Each region has its own constraints (i.e. flags).
  */
-int mod_subdivide(unsigned int size, Vertex* data, ModData* mod);
+int mod_subdivide(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Applies iterative relaxation to solve all 2D constraints.
@@ -68,19 +203,27 @@ int mod_subdivide(unsigned int size, Vertex* data, ModData* mod);
  * - roughness
  * - position
  */
-int mod_relax(unsigned int size, Vertex* data, ModData* mod);
+int mod_relax(unsigned int size, Vertices* data, ModData* mod);
+
+/**
+ * Applies the same relaxation as mod_relax, but as multigrid V-cycles.
+ * Coarser levels are relaxed first, their corrections are interpolated back up.
+ * Note: size must be of the form 2^N+1.
+ */
+int mod_relax_multigrid(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Flattens the terrain to 1D.
  * It copies the center (rounded down) column to all other columns.
  */
-int mod_flatten(unsigned int size, Vertex* data, ModData* mod);
+int mod_flatten(unsigned int size, Vertices* data, ModData* mod);
 
 /**
  * Applies iterative relaxation to solve 1D slope constraints.
  * It computes this on the center (rounded down) column.
+ * In DIRECT mode it projects onto the constraints in one go instead, see SLOPE_1D_COMPARE.
  */
-int mod_relax_slope_1d(unsigned int size, Vertex* data, ModData* mod);
+int mod_relax_slope_1d(unsigned int size, Vertices* data, ModData* mod);
 
 
 #endif
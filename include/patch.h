@@ -2,7 +2,8 @@
 #ifndef PATCH_H
 #define PATCH_H
 
-#include "deps.h"
+#include <cglm/cglm.h>
+#include <pthread.h>
 
 /* Calculation mode */
 typedef enum
@@ -10,11 +11,35 @@ typedef enum
 	READ_FILE,
 	SEQUENTIAL,
 	PARALLEL,
-	GPU /* TODO: Not yet operational */
+	GPU, /* TODO: Not yet operational */
+	COLORED, /* Sequential, but multi-coloured so it can run in parallel */
+	ACTIVE,  /* Sequential, but only revisits vertices near recent changes */
+	MULTIGRID,
+	DIRECT,  /* Direct solvers where there are any (1D slopes), sequential otherwise */
+	ENVELOPE /* Slope regions are made feasible in one go first, then active set */
 
 } ModMode;
 
 
+/* Acceleration scheme of iterative relaxation */
+typedef enum
+{
+	PLAIN,      /* Plain projections */
+	OVER_RELAX, /* Successive over-relaxation, all moves are scaled by omega */
+	CHEBYSHEV   /* Chebyshev semi-iterative acceleration, parallel only */
+
+} AccelType;
+
+
+/* Acceleration, the type and its tunable parameter */
+typedef struct
+{
+	AccelType type;
+	float     param; /* Omega for OVER_RELAX, spectral radius for CHEBYSHEV, <= 0 for default */
+
+} Accel;
+
+
 /* Constraint flags applied to vertices */
 typedef enum
 {
@@ -26,14 +51,16 @@ typedef enum
 } VertexFlag;
 
 
-/* A vertex */
+/* Vertex data, stored as a structure of arrays */
+/* Each array holds one value for all size * size vertices (column-major) */
+/* This so sweeps only reading heights don't drag the constraints along */
 typedef struct
 {
-	float h;
-	float c[3]; /* Constraint values */
-	int flags;  /* See type VertexFlag */
+	float*         h;
+	float*         c[3];  /* Constraint values */
+	unsigned char* flags; /* See type VertexFlag */
 
-} Vertex;
+} Vertices;
 
 
 /* Intermediate data for iterative modification */
@@ -42,61 +69,134 @@ typedef struct
 	void*        mod;        /* In reality a function pointer to the modifier in question */
 	const char*  out;        /* Output file, if any */
 	ModMode      mode;
-	Vertex*      snap; /* TODO: Not yet operational */
+	Accel        accel;
 
 	int          done;       /* Non-zero when no iterations will be done anymore */
+	int          converged;  /* Non-zero if done because it converged, not because it ran out of iterations */
 	unsigned int iterations; /* Number of iterations done */
-	Vertex*      buffer;
-	Vertex*      local[9];   /* The 3x3 (column-major) constraining local neighbourhood of patches */
+	unsigned int steps;      /* Iterations to do per call, 0 for STEP_SIZE */
+	double       cost;       /* Estimated seconds per iteration, 0 if unknown */
+	double       time;       /* Seconds spent in the modifier in total */
+	float*       buffer;     /* Buffer of heights */
+	void*        work;       /* Modifier specific working memory, freed with free() */
+	float*       local[9];   /* Heights of the 3x3 (column-major) constraining local neighbourhood of patches */
 
 } ModData;
 
 
+/* Snapshot of the vertex data of a patch, what gets rendered */
+typedef struct
+{
+	float*         h;
+	unsigned char* flags;
+
+} Snapshot;
+
+
 /* Patch definition */
 typedef struct
 {
 	vec3 pos; /* Position, modify at free will */
 
-	unsigned int size; /* Width and height in vertices (always a square) */
-	Vertex*      data; /* Column-major, generally speaking values are in [0,1] */
-	ModData*     mods; /* Modifiers running 'in the background' */
+	unsigned int size;  /* Width and height in vertices (always a square) */
+	Vertices     data;  /* Column-major, generally speaking heights are in [0,1] */
+	ModData*     mods;  /* Modifiers running in the background */
 	size_t       num_mods;
 	ModMode      mode;
+	Accel        accel;
+	float*       local; /* Copy of the neighbourhood's heights at the time of population */
 
-	GLuint       vao;
-	GLuint       vertices;
-	GLuint       indices;
+	/* Batch to run the modifiers in, or NULL to give the patch a worker of its own */
+	/* Set it before populate_patch, at which point the patch joins the batch */
+	struct PatchBatch* batch;
+
+	/* The modifiers run on a worker thread, which owns data and mods while running */
+	/* It publishes snapshots, which are triple buffered so no thread waits for a copy */
+	/* The worker owns back, whoever calls update_patch owns front, ready is handed between them */
+	/* Everything below is protected by lock, apart from back and front */
+	pthread_t       worker;
+	pthread_mutex_t lock;
+	int             has_worker; /* Non-zero if the worker still needs to be joined */
+	int             quit;       /* Non-zero to ask the worker to stop */
+	int             done;       /* Non-zero when all modifiers are done */
+	int             failed;     /* Non-zero if some modifier failed */
+	int             fresh;      /* Non-zero if ready holds a snapshot front hasn't seen */
+	float*          snaps;      /* Memory of all snapshots, they keep swapping */
+	Snapshot        back;
+	Snapshot        ready;
+	Snapshot        front;
 
 } Patch;
 
 
+/* Patches whose modifiers run together, instead of on a worker thread each */
+/* A single worker runs rounds, each round is one job on the thread pool with a task per patch */
+/* So many patches share the processors, and the scene converges as the slowest patch does */
+typedef struct PatchBatch
+{
+	pthread_t       worker;
+	pthread_mutex_t lock;
+	pthread_cond_t  wake;     /* Signals new patches, the end of a round or to quit */
+	Patch**         patches;  /* Patches with modifiers left to run */
+	size_t          count;
+	size_t          capacity;
+	Patch**         round;    /* Patches of the running round, longest slice first */
+	size_t          round_count;
+	int             quit;     /* Non-zero to ask the worker to stop */
+
+} PatchBatch;
+
+
 /**
  * Patch generator definition, a function pointer.
  *
  * @param  size  Width and height of the patch in vertices.
- * @param  data  Output data array of size * size length (column-major).
+ * @param  data  Output vertex data of size * size vertices (column-major).
  * @return       Zero if the generation failed for some reason.
  */
-typedef int (*PatchGenerator)(unsigned int size, Vertex* data);
+typedef int (*PatchGenerator)(unsigned int size, Vertices* data);
 
 /**
  * Patch modifier, yet again, a function pointer.
  *
  * @param  size  Width and height of the patch in vertices.
- * @param  data  Pointer to an input data array of size * size length (column-major).
+ * @param  data  Input vertex data of size * size vertices (column-major).
  * @param  mod   Modifier specific data to pass.
  * @return       Zero if the modification failed for some reason.
  */
-typedef int (*PatchModifier)(unsigned int size, Vertex* data, ModData* mod);
+typedef int (*PatchModifier)(unsigned int size, Vertices* data, ModData* mod);
+
+/**
+ * Reads a calculation mode and acceleration from a string, e.g. "s", "p" or "pc0.999".
+ * The first character is the mode, see main.c, optionally followed by an acceleration.
+ *
+ * @param  str    Null terminated string to read.
+ * @param  mode   Output mode, left untouched if the mode is not recognized.
+ * @param  accel  Output acceleration, PLAIN if none was given.
+ */
+void read_mode(const char* str, ModMode* mode, Accel* accel);
+
+/**
+ * Allocates vertex data for size * size vertices, all initialized to zero.
+ *
+ * @return  Zero if allocation failed.
+ */
+int create_vertices(Vertices* data, unsigned int size);
+
+/**
+ * Frees vertex data.
+ */
+void destroy_vertices(Vertices* data);
 
 /**
  * Creates a new patch of some specified size.
  *
- * @param  mode  Mode to use for calculation logic in all modifiers.
- * @param  size  Width and height of the patch in vertices.
- * @return       Zero if creation failed.
+ * @param  mode   Mode to use for calculation logic in all modifiers.
+ * @param  accel  Acceleration to use in all iterative modifiers.
+ * @param  size   Width and height of the patch in vertices.
+ * @return        Zero if creation failed.
  */
-int create_patch(Patch* patch, ModMode mode, unsigned int size);
+int create_patch(Patch* patch, ModMode mode, Accel accel, unsigned int size);
 
 /**
  * Destroys a patch.
@@ -110,14 +210,20 @@ void destroy_patch(Patch* patch);
 int is_patch(Patch* patch);
 
 /**
- * Draws a patch.
+ * Creates a batch and starts its worker, patches join it by setting their batch field.
  *
- * Note: Assumes some shader program is bound and set up.
+ * @return  Zero if creation failed.
+ */
+int create_patch_batch(PatchBatch* batch);
+
+/**
+ * Destroys a batch, all patches in it must be destroyed first.
  */
-void draw_patch(Patch* patch);
+void destroy_patch_batch(PatchBatch* batch);
 
 /**
  * Populates the patch with vertex data given a generator and modifiers.
+ * The modifiers are then run on a worker thread, or in its batch, see update_patch.
  *
  * @param  generator  Function that generates a terrain.
  * @param  mods       Array of modifiers (can be NULL), last element must be NULL.
@@ -133,16 +239,28 @@ int populate_patch(
 	Patch*         local[]);
 
 /**
- * Updates a patch, i.e. runs all modifiers that still need to iterate.
+ * Updates a patch, i.e. picks up the latest snapshot the modifiers published.
+ * Afterwards it is in front, which is left alone if there is no new snapshot.
+ * So it never waits for the modifiers.
  *
- * @return  Zero if some modifier failed.
+ * @param  fresh  Set to non-zero if front holds a new snapshot, can be NULL.
+ * @return        Zero if some modifier failed.
  */
-int update_patch(Patch* patch);
+int update_patch(Patch* patch, int* fresh);
 
 /**
  * Checks if a patch is done with all its current modifiers.
  */
 int is_patch_done(Patch* patch);
 
+/**
+ * Builds the vertex data a mesh renders from a snapshot, without touching the GPU.
+ * Each vertex is 9 floats, its position, normal and color.
+ *
+ * @param  size  Width and height of the snapshot in vertices.
+ * @param  out   Output of size * size * 9 floats (column-major).
+ */
+void build_snapshot_vertices(unsigned int size, Snapshot* snap, float* out);
+
 
 #endif
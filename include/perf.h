@@ -0,0 +1,55 @@
+
+#ifndef PERF_H
+#define PERF_H
+
+#include "constants.h"
+#include <stdio.h>
+
+/* Hardware performance counters around the solver phases, Linux only */
+/* Counters are per thread, only the thread calling PERF_BEGIN/PERF_END is counted */
+/* So in parallel modes only the share of the calling thread is in the numbers */
+/* With USE_PERF_COUNTERS at 0 all macros expand to nothing */
+#if USE_PERF_COUNTERS
+	#define PERF_BEGIN(phase) begin_perf(phase)
+	#define PERF_END(phase) end_perf(phase)
+	#define PERF_WRITE(file) write_perf(file)
+#else
+	#define PERF_BEGIN(phase)
+	#define PERF_END(phase)
+	#define PERF_WRITE(file)
+#endif
+
+
+/* A counted phase */
+typedef enum
+{
+	PERF_SWEEP,     /* A relaxation sweep over the slope/roughness constraints */
+	PERF_POSITION,  /* The position constraint pass following it */
+	PERF_FIND_PATH, /* Finding all paths of the subdivision */
+	PERF_STATS,     /* Gathering terrain stats */
+	PERF_PHASES
+
+} PerfPhase;
+
+
+/**
+ * Reads the counters at the start of a phase, use PERF_BEGIN.
+ * Opens the counters of the calling thread the first time it is called.
+ */
+void begin_perf(PerfPhase phase);
+
+/**
+ * Adds the counts since begin_perf to the totals of the phase, use PERF_END.
+ */
+void end_perf(PerfPhase phase);
+
+/**
+ * Writes the totals of the calling thread as a JSON field and resets them, use PERF_WRITE.
+ * Writes null if no counters are available, e.g. in containers.
+ *
+ * @param  f  File positioned within a JSON object, after its last field.
+ */
+void write_perf(FILE* f);
+
+
+#endif
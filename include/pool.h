@@ -0,0 +1,89 @@
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/**
+ * Task to run on the thread pool, a function pointer.
+ *
+ * @param  i     Index of the task, in [0, count).
+ * @param  data  Data that was given to pool_run.
+ */
+typedef void (*PoolTask)(unsigned int i, void* data);
+
+/**
+ * Task running a range of indices at once, a function pointer.
+ *
+ * @param  begin  First index of the range.
+ * @param  end    One past the last index of the range.
+ * @param  data   Data that was given to pool_for.
+ */
+typedef void (*PoolRangeTask)(unsigned int begin, unsigned int end, void* data);
+
+/* A node of a task graph, see pool_graph */
+typedef struct
+{
+	unsigned int        count;    /* Number of tasks, as for pool_run */
+	PoolTask            task;
+	void*               data;
+	const unsigned int* deps;     /* Indices of the nodes that must be done first, can be NULL */
+	unsigned int        num_deps;
+
+} PoolNode;
+
+
+/**
+ * Runs a number of tasks on the thread pool and waits for all of them to finish.
+ * The calling thread helps out, so it is never idle while waiting.
+ * The pool is created on first use with NUM_THREADS threads.
+ *
+ * @param  count  Number of tasks to run, each gets an index in [0, count).
+ * @param  task   Function to call for each index.
+ * @param  data   Data to pass to each call.
+ *
+ * Note: calls from different threads, or from within a task, all share the pool.
+ * Each thread has a queue of its own, idle threads steal from the others.
+ * Threads outside the pool only help with their own tasks, never those of other calls.
+ */
+void pool_run(unsigned int count, PoolTask task, void* data);
+
+/**
+ * Parallel for, runs ranges of at most grain indices in [0, count) and waits for them.
+ * E.g. over the columns of a patch, when a task per column is too fine.
+ *
+ * @param  grain  Maximum number of indices per call to task, 0 to split evenly over all threads.
+ */
+void pool_for(unsigned int count, unsigned int grain, PoolRangeTask task, void* data);
+
+/**
+ * Runs a task graph and waits for all of it to finish.
+ * The tasks of a node start once all nodes it depends on are done.
+ *
+ * @param  count  Number of nodes.
+ * @param  nodes  The nodes, dependencies must not form a cycle.
+ */
+void pool_graph(unsigned int count, PoolNode* nodes);
+
+/**
+ * Returns scratch memory private to the calling thread, so tasks don't need to allocate.
+ * It is valid until the next call to pool_scratch on the same thread, and freed when it exits.
+ *
+ * @param  size  Number of bytes needed.
+ * @return       NULL if it could not be allocated.
+ */
+void* pool_scratch(size_t size);
+
+/**
+ * Returns the number of threads that run tasks, including the calling thread.
+ */
+unsigned int pool_threads(void);
+
+/**
+ * Destroys the thread pool, it will be recreated on next use.
+ * Must not be called while tasks are running.
+ */
+void destroy_pool(void);
+
+
+#endif
@@ -3,6 +3,7 @@
 #define SCENE_H
 
 #include "deps.h"
+#include "mesh.h"
 #include "patch.h"
 #include "shader.h"
 
@@ -16,15 +17,27 @@ typedef struct
 } Camera;
 
 
+/* Patch of a scene, along with the mesh to draw it with */
+typedef struct
+{
+	Patch patch;
+	Mesh  mesh;
+	int   fresh; /* Non-zero if the mesh is behind on the patch, see update_scene */
+
+} ScenePatch;
+
+
 /* Scene deinition */
 typedef struct
 {
 	Camera       camera;
-	Patch*       patches;
+	ScenePatch** patches;   /* Pointers, so patches don't move while their modifiers run */
+	PatchBatch   batch;     /* Runs the modifiers of all patches */
 	unsigned int grid_size; /* Width/height of each quadrant */
 	unsigned int patch_size;
 	Shader       patch_shader;
 	ModMode      patch_mode;
+	Accel        patch_accel;
 
 	/* Selection (helper) graphics */
 	ivec3  help_pos;
@@ -45,11 +58,12 @@ typedef struct
  * Creates a new scene.
  *
  * @param  mode       Mode to use for calculation logic in all modifiers.
+ * @param  accel      Acceleration to use in all iterative modifiers.
  * @param  patchSize  Width and height of all patches in vertices.
  *                    Set to DEF_PATCH_SIZE if value < 2.
  * @return            Zero if the scene creation failed.
  */
-int create_scene(Scene* scene, ModMode mode, unsigned int patchSize);
+int create_scene(Scene* scene, ModMode mode, Accel accel, unsigned int patchSize);
 
 /**
  * Destroys a scene.
@@ -69,7 +83,7 @@ int scene_add_patch(Scene* scene);
 void draw_scene(Scene* scene);
 
 /**
- * Updates the scene.
+ * Updates the scene, i.e. picks up what the modifiers of all patches published.
  *
  * @param  dTime  Delta time of the current frame.
  */
@@ -0,0 +1,108 @@
+
+#ifndef TERR_H
+#define TERR_H
+
+/* Public API of libterr, the compute core without any rendering */
+/* Only plain C types, so it can be used from anywhere, e.g. Python's ctypes */
+/* Note: generation uses rand(), so don't generate from multiple threads at once */
+#if defined(__GNUC__)
+	#define TERR_API __attribute__((visibility("default")))
+#else
+	#define TERR_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Patch handle, its definition is private */
+typedef struct TerrPatch TerrPatch;
+
+
+/* Modifiers that can be added to a patch */
+typedef enum
+{
+	TERR_SUBDIVIDE = 0, /* Generate paths and constraints */
+	TERR_RELAX     = 1, /* Relax the constraints, iteratively */
+	TERR_STATS     = 2, /* Output constraint statistics */
+	TERR_OUTPUT    = 3  /* Output the heights as JSON */
+
+} TerrModifier;
+
+
+/**
+ * Creates a new patch.
+ *
+ * @param  size  Width and height of the patch in vertices, 2^N+1 for multigrid.
+ * @param  mode  Calculation mode, as passed to terr (e.g. "s", "p" or "pc0.999").
+ * @return       The new patch, NULL on failure.
+ */
+TERR_API TerrPatch* terr_create(unsigned int size, const char* mode);
+
+/**
+ * Destroys a patch.
+ */
+TERR_API void terr_destroy(TerrPatch* patch);
+
+/**
+ * Generates a new terrain with midpoint displacement.
+ * This also clears all constraints and restarts all modifiers.
+ *
+ * @param  seed  Seed of the random generator, must be > 0.
+ * @return       Zero on failure.
+ */
+TERR_API int terr_generate(TerrPatch* patch, unsigned int seed);
+
+/**
+ * Adds a modifier, they run in the order they are added.
+ *
+ * @param  mod  See TerrModifier.
+ * @param  out  File to append the modifier's output to, can be NULL.
+ *              For TERR_RELAX this is the iteration count, must outlive the patch.
+ * @return      Zero on failure.
+ */
+TERR_API int terr_add_modifier(TerrPatch* patch, TerrModifier mod, const char* out);
+
+/**
+ * Runs the modifiers on the calling thread.
+ *
+ * @param  iterations  Maximum number of iterations to run, 0 to run until all are done.
+ * @return             Zero if some modifier failed.
+ */
+TERR_API int terr_run(TerrPatch* patch, unsigned int iterations);
+
+/**
+ * Returns non-zero if all modifiers are done.
+ */
+TERR_API int terr_is_done(TerrPatch* patch);
+
+/**
+ * Returns the number of iterations all modifiers did since the last generation.
+ */
+TERR_API unsigned int terr_get_iterations(TerrPatch* patch);
+
+/**
+ * Returns the width and height of the patch in vertices.
+ */
+TERR_API unsigned int terr_get_size(TerrPatch* patch);
+
+/**
+ * Copies the heights of the patch.
+ *
+ * @param  out  Output of size * size floats, column-major.
+ */
+TERR_API void terr_get_heights(TerrPatch* patch, float* out);
+
+/**
+ * Copies the constraint flags of the patch.
+ *
+ * @param  out  Output of size * size bytes, column-major.
+ */
+TERR_API void terr_get_flags(TerrPatch* patch, unsigned char* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
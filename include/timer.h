@@ -0,0 +1,12 @@
+
+#ifndef TIMER_H
+#define TIMER_H
+
+/**
+ * Returns the current time in seconds.
+ * Only differences are meaningful, the clock starts at some arbitrary point.
+ */
+double get_time(void);
+
+
+#endif
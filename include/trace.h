@@ -0,0 +1,49 @@
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "constants.h"
+#include "timer.h"
+
+/* Scoped timers, exported as Chrome trace events (chrome://tracing or Perfetto) */
+/* Each thread records on a track of its own, so each patch's worker gets one */
+/* With USE_TRACE at 0 all macros expand to nothing, so it costs nothing at all */
+#if USE_TRACE
+	#define TRACE_BEGIN(id) double trace_##id = get_time()
+	#define TRACE_END(id, name) add_trace(name, trace_##id, get_time())
+	#define TRACE_THREAD(name) begin_trace_thread(name)
+	#define TRACE_WRITE(file) write_trace(file)
+#else
+	#define TRACE_BEGIN(id)
+	#define TRACE_END(id, name)
+	#define TRACE_THREAD(name)
+	#define TRACE_WRITE(file)
+#endif
+
+
+/**
+ * Records an event on the track of the calling thread, use TRACE_BEGIN and TRACE_END.
+ *
+ * @param  name   Static string, only the pointer is stored.
+ * @param  start  Time the event started, see get_time.
+ * @param  end    Time the event ended.
+ */
+void add_trace(const char* name, double start, double end);
+
+/**
+ * Gives the calling thread a new track, use TRACE_THREAD.
+ * Threads that never call this record on the track of the main thread.
+ *
+ * @param  name  Name of the track, it is numbered to tell tracks apart.
+ */
+void begin_trace_thread(const char* name);
+
+/**
+ * Writes all recorded events to a JSON file and forgets them, use TRACE_WRITE.
+ *
+ * @return  Zero if the file could not be written.
+ */
+int write_trace(const char* file);
+
+
+#endif
@@ -34,7 +34,12 @@ def readLines(filename):
 # If emd is False, opt will be False as well
 # Set opt to True to calculate the optimum and its EMD
 # Set opt to False if we just want the normal EMD
-def results(size, emd, opt, Ns, filecode):
+# The mode is the calculation mode passed to the program (e.g. s or c)
+# It can be followed by an acceleration (e.g. sr1.5 or pc0.999), see main.c
+# Run the same Ns and size with and without it to compare iteration counts
+# Set batch to True to run all samples in one go with terr_batch, only if emd is False
+# It writes the same iterations and stats .txt, but not the terrain .json files
+def results(size, emd, opt, Ns, filecode, mode='s', batch=False):
     # First create the results directory in case this fails
     try:
         os.makedirs(RESULTS_OUT)
@@ -49,12 +54,19 @@ def results(size, emd, opt, Ns, filecode):
     if emd:
         open(EMD_FILE, 'w').close()
 
-    # Now run all Ns samples
+    # Without EMDs we only need the iterations and stats .txt
+    # So if asked, run all Ns samples in one go with the headless batch driver
     # Giving a new seed to the terrain generator every time
-    for i in range(0,Ns):
+    batch = batch and not emd
+    if batch:
+        run("./terr_batch {} {} 1-{}".format(size, mode, Ns), "1-{}".format(Ns))
+
+    # Otherwise run all Ns samples one by one
+    for i in range(0,0 if batch else Ns):
         # Run the iterative relaxation algorithm
         # This gives us all the terrain .json files and the iterations and stats .txt
-        run("./terr {} s {} 1".format(size, i+1), i+1)
+        # It runs automatically with a hidden window, so it isn't held back by drawing
+        run("./terr {} {} {} h".format(size, mode, i+1), i+1)
         if emd:
             # Calculate the EMD of the above to the EMD .txt
             run("./EMD.py", i+1)
@@ -83,6 +95,7 @@ def results(size, emd, opt, Ns, filecode):
     # Create a JSON object that summarizes all results
     results = {
         "size" : size,
+        "mode" : mode,
         "samples" : Ns,
         "emds" : emds,
         "emds_opt" : emds_opt,
@@ -110,6 +123,10 @@ if __name__ == '__main__':
         print("--   opt   True to calculate the optimum and its EMD (False if emd is False).")
         print("--   Ns    Sample size, i.e. number of random terrains to evaluate.")
         print("--   code  Code to append to the output results .json file.")
+        print("--   mode  Optional calculation mode, s (default), p, c, ...")
+        print("--         Optionally followed by an acceleration, r[omega] or c[rho] (e.g. sr1.5, pc0.999).")
+        print("--   batch Optional, True to run all samples in one go with terr_batch (not with emd).")
+        print("--         It skips the terrain .json files, build it first.")
     else:
         bStrs = ['y', 'yes', 't', 'true', 'on', '1']
 
@@ -119,5 +136,7 @@ if __name__ == '__main__':
         opt = sys.argv[3].lower() in bStrs
         Ns = int(sys.argv[4])
         code = sys.argv[5]
+        mode = sys.argv[6] if len(sys.argv) > 6 else 's'
+        batch = sys.argv[7].lower() in bStrs if len(sys.argv) > 7 else False
 
-        results(size, emd, opt, Ns, code)
+        results(size, emd, opt, Ns, code, mode, batch)
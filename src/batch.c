@@ -0,0 +1,258 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "constants.h"
+#include "generators.h"
+#include "modifiers.h"
+#include "output.h"
+#include "patch.h"
+#include "pool.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Maximum number of sizes to run in one go */
+#define MAX_SIZES  16
+
+/* Output files that are written per sample, the same ones terr appends to */
+#define NUM_OUTS  3
+
+static const char* outs[NUM_OUTS] = {
+	OUT_FILE_STATS_L,
+	OUT_FILE_ITERS,
+	OUT_FILE_STATS_H
+};
+
+
+/* A single experiment, one seed at one size */
+/* Its records are first written to files of its own, so samples don't interleave */
+typedef struct
+{
+	Patch        patch;
+	unsigned int index;
+	int          running;
+	char         files[NUM_OUTS][64];
+
+} Sample;
+
+
+/*****************************/
+static void get_sample_file(char* file, const char* out, unsigned int index)
+{
+	sprintf(file, "%s.%u", out, index);
+}
+
+/*****************************/
+static int start_sample(
+	Sample*      sample,
+	unsigned int index,
+	unsigned int size,
+	unsigned int seed,
+	ModMode      mode,
+	Accel        accel,
+	PatchBatch*  batch)
+{
+	/* The same modifiers as a scene, minus the terrain outputs */
+	/* Those are only of use to EMD.py, which needs to run per sample anyway */
+	PatchModifier mods[] = {
+		mod_subdivide,
+		mod_stats,
+		mode == MULTIGRID ? mod_relax_multigrid : mod_relax,
+		mod_stats,
+		NULL
+	};
+
+	const char* files[] = {
+		NULL,
+		sample->files[0],
+		sample->files[1],
+		sample->files[2]
+	};
+
+	unsigned int o;
+	for(o = 0; o < NUM_OUTS; ++o)
+		get_sample_file(sample->files[o], outs[o], index);
+
+	if(!create_patch(&sample->patch, mode, accel, size))
+		return 0;
+
+	sample->patch.batch = batch;
+
+	/* Generation is done right here on this thread, so seeding is deterministic */
+	/* Only the modifiers run in the background */
+	srand(seed);
+	if(!populate_patch(&sample->patch, gen_mpd, mods, files, NULL))
+	{
+		destroy_patch(&sample->patch);
+		return 0;
+	}
+
+	sample->index = index;
+	sample->running = 1;
+
+	return 1;
+}
+
+/*****************************/
+static void merge_outputs(unsigned int count)
+{
+	/* Append the records of all samples in order, as if terr ran them one by one */
+	TRACE_BEGIN(merge);
+	char file[64];
+	char buf[4096];
+
+	unsigned int o, i;
+	for(o = 0; o < NUM_OUTS; ++o)
+	{
+		FILE* f = fopen(outs[o], "a");
+		if(f == NULL)
+		{
+			throw_error("Could not open file: %s", outs[o]);
+			continue;
+		}
+
+		for(i = 0; i < count; ++i)
+		{
+			get_sample_file(file, outs[o], i);
+			FILE* s = fopen(file, "r");
+			if(s == NULL)
+				continue;
+
+			size_t n;
+			while((n = fread(buf, 1, sizeof(buf), s)) > 0)
+				fwrite(buf, 1, n, f);
+
+			fclose(s);
+			remove(file);
+		}
+
+		fclose(f);
+		output("Records have been written to file: %s", outs[o]);
+	}
+
+	TRACE_END(merge, "merge_outputs");
+}
+
+/*****************************/
+int main(int argc, char* argv[])
+{
+	/* Input is similar to terr */
+	/* - First argument is a comma separated list of grid sizes, e.g. 65,129 */
+	/* - Second argument determines the mode, as for terr */
+	/* - Third argument is a range of seeds, e.g. 1-100, or a single one */
+	/* - Fourth argument is the number of samples to run at once, default one per thread */
+	if(argc < 4)
+	{
+		throw_error("Usage: terr_batch <resolutions> <mode> <seeds> <jobs>");
+		return EXIT_FAILURE;
+	}
+
+	unsigned int sizes[MAX_SIZES];
+	unsigned int numSizes = 0;
+
+	char* str = argv[1];
+	while(*str != '\0' && numSizes < MAX_SIZES)
+	{
+		sizes[numSizes] = strtoul(str, &str, 10);
+		if(sizes[numSizes] >= 2)
+			++numSizes;
+		if(*str == ',')
+			++str;
+		else
+			break;
+	}
+
+	ModMode mode = SEQUENTIAL;
+	Accel accel;
+	read_mode(argv[2], &mode, &accel);
+
+	unsigned int first = strtoul(argv[3], &str, 10);
+	unsigned int last = (*str == '-') ? strtoul(str + 1, NULL, 10) : first;
+
+	unsigned int jobs = (argc > 4) ? strtoul(argv[4], NULL, 10) : 0;
+	if(jobs < 1)
+		jobs = pool_threads();
+
+	if(numSizes == 0 || first < 1 || last < first)
+	{
+		throw_error("Invalid resolutions or seeds, seeds must be > 0.");
+		return EXIT_FAILURE;
+	}
+
+	/* All samples, size by size, seed by seed */
+	/* Start new ones whenever a job is free */
+	unsigned int seeds = last - first + 1;
+	unsigned int count = numSizes * seeds;
+
+	Sample* samples = calloc(jobs, sizeof(Sample));
+	if(samples == NULL)
+	{
+		throw_error("Failed to allocate memory for samples.");
+		return EXIT_FAILURE;
+	}
+
+	/* All running samples relax together, as one job on the thread pool */
+	PatchBatch batch;
+	if(!create_patch_batch(&batch))
+	{
+		free(samples);
+		return EXIT_FAILURE;
+	}
+
+	output("Running %u samples, %u at a time.", count, jobs);
+
+	unsigned int next = 0;
+	unsigned int finished = 0;
+	int failed = 0;
+
+	while(finished < count)
+	{
+		unsigned int j;
+		for(j = 0; j < jobs; ++j)
+		{
+			Sample* s = samples + j;
+
+			/* Start a new sample in a free job */
+			if(!s->running && next < count)
+			{
+				unsigned int i = next++;
+				unsigned int size = sizes[i / seeds];
+				if(!start_sample(s, i, size, first + i % seeds, mode, accel, &batch))
+				{
+					throw_error("Could not start sample %u.", i);
+					failed = 1;
+					++finished;
+				}
+
+				continue;
+			}
+
+			/* Check on the running ones */
+			/* Which also picks up snapshots, so they can be done */
+			if(s->running)
+			{
+				failed |= !update_patch(&s->patch, NULL);
+				if(is_patch_done(&s->patch))
+				{
+					destroy_patch(&s->patch);
+					s->running = 0;
+					++finished;
+				}
+			}
+		}
+
+		/* Don't take time away from the samples */
+		struct timespec t = { .tv_sec = 0, .tv_nsec = 1000000 };
+		nanosleep(&t, NULL);
+	}
+
+	free(samples);
+	destroy_patch_batch(&batch);
+	merge_outputs(count);
+	destroy_pool();
+
+	TRACE_WRITE(OUT_FILE_TRACE);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
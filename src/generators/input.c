@@ -16,7 +16,7 @@ static unsigned int read_index = 0;
 
 
 /*****************************/
-int gen_file(unsigned int size, Vertex* data)
+int gen_file(unsigned int size, Vertices* data)
 {
 	/* Check if there are any files left to open */
 	if(read_index >= sizeof(read_files) / sizeof(char*))
@@ -48,8 +48,10 @@ int gen_file(unsigned int size, Vertex* data)
 	unsigned int i;
 	for(i = 0; i < size*size; ++i)
 	{
-		fscanf(f, " %*[][, \n] %f", &(data[i].h));
-		fscanf(ff, " %*[][, \n] %i", &(data[i].flags));
+		int flags = 0;
+		fscanf(f, " %*[][, \n] %f", data->h + i);
+		fscanf(ff, " %*[][, \n] %i", &flags);
+		data->flags[i] = flags;
 	}
 
 	/* Go to next file */
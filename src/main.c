@@ -1,13 +1,20 @@
 
 #include "deps.h"
 #include "output.h"
+#include "pool.h"
 #include "scene.h"
+#include "trace.h"
 #include <stdlib.h>
 
 /* Window dimensions */
 #define WINDOW_WIDTH   1200 /* 1200 normal, 800 for screenshots */
 #define WINDOW_HEIGHT  600
 
+/* In automatic mode, redraw at most AUTO_FPS times per second */
+/* And check if the scene is done AUTO_POLL times per second */
+#define AUTO_FPS       10
+#define AUTO_POLL      100
+
 /* Scene to forward input callbacks to */
 static Scene* active_scene = NULL;
 
@@ -43,6 +50,12 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 /*****************************/
 int main(int argc, char* argv[])
 {
+	/* Check for automatic mode first, it might hide the window */
+	/* - Fourth argument sets the program to automatic (any value sets it) */
+	/*    h = also hide the window, nothing is drawn at all */
+	int aut = argc > 4;
+	int hidden = aut && argv[4][0] == 'h';
+
 	/* Initialize GLFW */
 	if(!glfwInit())
 	{
@@ -56,6 +69,7 @@ int main(int argc, char* argv[])
 	/* Create a window */
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_VISIBLE, hidden ? GLFW_FALSE : GLFW_TRUE);
 
 	GLFWwindow* win = glfwCreateWindow(
 		WINDOW_WIDTH, WINDOW_HEIGHT, "Terrainz", NULL, NULL);
@@ -74,7 +88,8 @@ int main(int argc, char* argv[])
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
 	/* Initialize the window */
-	glfwSwapInterval(1);
+	/* The modifiers run in the background, so in automatic mode nothing waits for vsync */
+	glfwSwapInterval(aut ? 0 : 1);
 	glfwSetFramebufferSizeCallback(win, framebuffer_size_callback);
 	glfwSetKeyCallback(win, key_callback);
 
@@ -85,27 +100,30 @@ int main(int argc, char* argv[])
 	/*    s = sequential */
 	/*    p = parallel */
 	/*    g = gpu (parallel) */
+	/*    c = multi-coloured sequential (parallel) */
+	/*    a = active set sequential */
+	/*    m = multigrid sequential */
+	/*    d = direct where possible (1D slopes), sequential otherwise */
+	/*    e = envelope of slope regions first, then active set sequential */
+	/*   Optionally followed by an acceleration and its parameter (e.g. sr1.5 or pc0.99) */
+	/*    r = successive over-relaxation, parameter is omega */
+	/*    c = Chebyshev acceleration (parallel only), parameter is the spectral radius */
+	/*    Without a parameter a default is picked (see constants.h) */
 	/* - Third argument is the seed to use, must be > 0 */
-	/* - Fourth argument sets the program to automatic (any value sets it) */
+	/* - Fourth argument sets the program to automatic, see above */
 	Scene scene;
 	unsigned int pSize = 0;
 	ModMode mode = SEQUENTIAL;
-	int aut = 0;
+	Accel accel = { .type = PLAIN, .param = 0 };
 
 	if(argc > 1)
 		pSize = atoi(argv[1]);
-	if(argc > 2) mode =
-		argv[2][0] == 'f' ? READ_FILE :
-		argv[2][0] == 's' ? SEQUENTIAL :
-		argv[2][0] == 'p' ? PARALLEL :
-		argv[2][0] == 'g' ? GPU :
-		mode;
+	if(argc > 2)
+		read_mode(argv[2], &mode, &accel);
 	if(argc > 3)
 		srand(atoi(argv[3]));
-	if(argc > 4)
-		aut = 1;
 
-	if(!create_scene(&scene, mode, pSize))
+	if(!create_scene(&scene, mode, accel, pSize))
 	{
 		throw_error("Could not create a scene.");
 		goto terminate;
@@ -125,16 +143,22 @@ int main(int argc, char* argv[])
 	/* Then enter the main loop */
 	if(aut) scene_add_patch(&scene);
 	double time = glfwGetTime();
+	double drawTime = time - 1.0 / AUTO_FPS;
 
 	while(!glfwWindowShouldClose(win))
 	{
 		/* Draw smth */
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		draw_scene(&scene);
-		glfwSwapBuffers(win);
+		/* When automatic, only every now and then, or never if hidden */
+		double newTime = glfwGetTime();
+		if(!aut || (!hidden && newTime - drawTime >= 1.0 / AUTO_FPS))
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			draw_scene(&scene);
+			glfwSwapBuffers(win);
+			drawTime = newTime;
+		}
 
 		/* Update scene */
-		double newTime = glfwGetTime();
 		update_scene(&scene, newTime - time);
 		time = newTime;
 
@@ -144,13 +168,21 @@ int main(int argc, char* argv[])
 			glfwSetWindowShouldClose(win, GLFW_TRUE);
 
 		/* Process events */
-		glfwPollEvents();
+		/* When automatic, sleep in between so the modifiers get all cores */
+		if(aut)
+			glfwWaitEventsTimeout(1.0 / AUTO_POLL);
+		else
+			glfwPollEvents();
 	}
 
 	/* Clean up the scene */
 	destroy_scene(&scene);
 	active_scene = NULL;
 
+	/* And the threads it might have used */
+	destroy_pool();
+	TRACE_WRITE(OUT_FILE_TRACE);
+
 terminate:
 	/* Terminate GLFW and exit */
 	glfwDestroyWindow(win);
@@ -0,0 +1,120 @@
+#include "constants.h"
+#include "deps.h"
+#include "mesh.h"
+#include "output.h"
+#include "pool.h"
+#include "trace.h"
+#include <stdlib.h>
+
+/*****************************/
+int create_mesh(Mesh* mesh, unsigned int size)
+{
+	mesh->size = size;
+
+	/* Allocate GPU memory and setup VAO */
+	/* Each vertex has a position, normal and color */
+	size_t vertSize = sizeof(float) * size * size * 9;
+	glGenVertexArrays(1, &mesh->vao);
+	glGenBuffers(1, &mesh->vertices);
+	glGenBuffers(1, &mesh->indices);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertices);
+	glBufferData(GL_ARRAY_BUFFER, vertSize, NULL, GL_STATIC_DRAW);
+
+	/* So we have 3 floats for the position, normal and color */
+	GLsizei attrSize = sizeof(float) * 3;
+	glBindVertexArray(mesh->vao);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	glVertexAttribPointer(
+		0, 3, GL_FLOAT, GL_FALSE, attrSize * 3, (GLvoid*)0);
+	glVertexAttribPointer(
+		1, 3, GL_FLOAT, GL_FALSE, attrSize * 3, (GLvoid*)(uintptr_t)attrSize);
+	glVertexAttribPointer(
+		2, 3, GL_FLOAT, GL_FALSE, attrSize * 3, (GLvoid*)(uintptr_t)(attrSize*2));
+
+	/* Generate some index data */
+	size_t indSize = sizeof(unsigned int) * 6 * (size-1) * (size-1);
+	unsigned int* ind = malloc(indSize);
+
+	if(ind == NULL)
+	{
+		throw_error("Failed to allocate memory to generate indices.");
+		destroy_mesh(mesh);
+
+		return 0;
+	}
+
+	/* Loop over all squares inbetween vertices, add two triangles */
+	/* Assumes the vertices are stored column-major */
+	unsigned int i, c, r;
+	for(i = 0, c = 0; c < (size-1); ++c)
+		for(r = 0; r < (size-1); ++r)
+		{
+			/* To the right being x, upwards being y: */
+			/* bottom left, top left, bottom right */
+			ind[i++] = c * size + r;
+			ind[i++] = c * size + r + 1;
+			ind[i++] = (c+1) * size + r;
+
+			/* top left, top right, bottom right */
+			ind[i++] = c * size + r + 1;
+			ind[i++] = (c+1) * size + r + 1;
+			ind[i++] = (c+1) * size + r;
+		}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indSize, ind, GL_STATIC_DRAW);
+	free(ind);
+
+	return 1;
+}
+
+/*****************************/
+void destroy_mesh(Mesh* mesh)
+{
+	glDeleteVertexArrays(1, &mesh->vao);
+	glDeleteBuffers(1, &mesh->vertices);
+	glDeleteBuffers(1, &mesh->indices);
+}
+
+/*****************************/
+int upload_mesh(Mesh* mesh, Snapshot* snap)
+{
+	/* Temporary buffer to generate vertex data */
+	TRACE_BEGIN(upload);
+	float* data = pool_scratch(sizeof(float) * mesh->size * mesh->size * 9);
+
+	if(data == NULL)
+	{
+		throw_error("Failed to allocate memory to generate vertices.");
+		return 0;
+	}
+
+	/* Compute it all, then upload it in one go */
+	build_snapshot_vertices(mesh->size, snap, data);
+	upload_mesh_vertices(mesh, data);
+
+	TRACE_END(upload, "upload_mesh");
+
+	return 1;
+}
+
+/*****************************/
+void upload_mesh_vertices(Mesh* mesh, const float* data)
+{
+	size_t vertSize = sizeof(float) * mesh->size * mesh->size * 9;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertices);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertSize, data);
+}
+
+/*****************************/
+void draw_mesh(Mesh* mesh)
+{
+	glBindVertexArray(mesh->vao);
+	size_t elems = 6 * (mesh->size-1) * (mesh->size-1);
+	glDrawElements(GL_TRIANGLES, elems, GL_UNSIGNED_INT, (GLvoid*)0);
+}
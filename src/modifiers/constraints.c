@@ -0,0 +1,131 @@
+#include "modifiers.h"
+#include "output.h"
+#include "patch.h"
+#include <math.h>
+#include <stdlib.h>
+
+/* Number of parameters of each type */
+#define SLOPE_PARAMS      1
+#define DIR_SLOPE_PARAMS  3
+#define ROUGHNESS_PARAMS  1
+#define POSITION_PARAMS   1
+
+
+/*****************************/
+static void* layout_list(
+	ConstraintList* list,
+	unsigned int    size,
+	unsigned int    count,
+	unsigned int    params,
+	void*           mem)
+{
+	/* Lay out the offsets, indices and each parameter one after the other */
+	list->offsets = mem;
+	list->ix = list->offsets + (size + 1);
+
+	float* p = (float*)(list->ix + count);
+	unsigned int i;
+	for(i = 0; i < 3; ++i)
+		list->p[i] = (i < params) ? p + i * count : NULL;
+
+	/* Return the memory right after it */
+	return p + params * count;
+}
+
+/*****************************/
+static size_t get_list_size(unsigned int size, unsigned int count, unsigned int params)
+{
+	return
+		sizeof(unsigned int) * (size + 1 + count) +
+		sizeof(float) * params * count;
+}
+
+/*****************************/
+Constraints* create_constraints(unsigned int size, Vertices* data)
+{
+	/* First count the entries of each type */
+	unsigned int slopes = 0, dirSlopes = 0, roughnesses = 0, positions = 0;
+	unsigned int ix;
+	for(ix = 0; ix < size * size; ++ix)
+	{
+		unsigned char flags = data->flags[ix];
+		slopes += (flags & SLOPE) != 0;
+		dirSlopes += (flags & DIR_SLOPE) != 0;
+		roughnesses += (flags & ROUGHNESS) != 0;
+		positions += (flags & POSITION) != 0;
+	}
+
+	/* Allocate the struct and all its lists in one go */
+	Constraints* cons = malloc(
+		sizeof(Constraints) +
+		get_list_size(size, slopes, SLOPE_PARAMS) +
+		get_list_size(size, dirSlopes, DIR_SLOPE_PARAMS) +
+		get_list_size(size, roughnesses, ROUGHNESS_PARAMS) +
+		get_list_size(size, positions, POSITION_PARAMS));
+
+	if(cons == NULL)
+	{
+		throw_error("Failed to allocate memory for compiled constraints.");
+		return NULL;
+	}
+
+	void* mem = cons + 1;
+	mem = layout_list(&cons->slope, size, slopes, SLOPE_PARAMS, mem);
+	mem = layout_list(&cons->dir_slope, size, dirSlopes, DIR_SLOPE_PARAMS, mem);
+	mem = layout_list(&cons->roughness, size, roughnesses, ROUGHNESS_PARAMS, mem);
+	mem = layout_list(&cons->position, size, positions, POSITION_PARAMS, mem);
+
+	/* Now fill them column by column */
+	/* Vertices are column-major, so the entries of each column end up next to each other */
+	slopes = dirSlopes = roughnesses = positions = 0;
+
+	unsigned int c, r;
+	for(c = 0; c < size; ++c)
+	{
+		cons->slope.offsets[c] = slopes;
+		cons->dir_slope.offsets[c] = dirSlopes;
+		cons->roughness.offsets[c] = roughnesses;
+		cons->position.offsets[c] = positions;
+
+		for(r = 0; r < size; ++r)
+		{
+			ix = c * size + r;
+			unsigned char flags = data->flags[ix];
+
+			if(flags & SLOPE)
+			{
+				cons->slope.ix[slopes] = ix;
+				cons->slope.p[0][slopes++] = data->c[0][ix];
+			}
+
+			/* The direction is normalized here, instead of every iteration */
+			if(flags & DIR_SLOPE)
+			{
+				float maxSlope = hypotf(data->c[0][ix], data->c[1][ix]);
+				cons->dir_slope.ix[dirSlopes] = ix;
+				cons->dir_slope.p[0][dirSlopes] = data->c[0][ix] / maxSlope;
+				cons->dir_slope.p[1][dirSlopes] = data->c[1][ix] / maxSlope;
+				cons->dir_slope.p[2][dirSlopes++] = maxSlope;
+			}
+
+			if(flags & ROUGHNESS)
+			{
+				cons->roughness.ix[roughnesses] = ix;
+				cons->roughness.p[0][roughnesses++] = data->c[0][ix];
+			}
+
+			if(flags & POSITION)
+			{
+				cons->position.ix[positions] = ix;
+				cons->position.p[0][positions++] = data->c[2][ix];
+			}
+		}
+	}
+
+	cons->slope.offsets[size] = slopes;
+	cons->dir_slope.offsets[size] = dirSlopes;
+	cons->roughness.offsets[size] = roughnesses;
+	cons->position.offsets[size] = positions;
+
+	return cons;
+}
@@ -0,0 +1,158 @@
+#include "constants.h"
+#include "modifiers.h"
+#include "output.h"
+#include "patch.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*****************************/
+static int is_region(Vertices* data, unsigned int ix)
+{
+	/* Only pure slope constraints, anything with a position has to stay put */
+	return data->flags[ix] == SLOPE;
+}
+
+/*****************************/
+static int sweep_envelopes(
+	unsigned int size,
+	Vertices*    data,
+	float        k,
+	float*       lo,
+	float*       hi,
+	int          forward)
+{
+	/* Each vertex looks at the column and row before it, in the direction of the sweep */
+	/* Like a distance transform, with the heights as distances to start from */
+	int changed = 0;
+	unsigned int n = size * size;
+	unsigned int j;
+	for(j = 0; j < n; ++j)
+	{
+		unsigned int ix = forward ? j : n-1 - j;
+		if(!is_region(data, ix))
+			continue;
+
+		unsigned int c = ix / size;
+		unsigned int r = ix % size;
+		unsigned int nb[2];
+		unsigned int count = 0;
+
+		if(forward && c > 0)      nb[count++] = ix - size;
+		if(forward && r > 0)      nb[count++] = ix - 1;
+		if(!forward && c < size-1) nb[count++] = ix + size;
+		if(!forward && r < size-1) nb[count++] = ix + 1;
+
+		while(count--)
+		{
+			unsigned int m = nb[count];
+			if(!is_region(data, m))
+				continue;
+
+			/* The bound of an edge satisfies both its ends */
+			float e = fminf(data->c[0][ix], data->c[0][m]) * k;
+			if(lo[m] + e < lo[ix])
+			{
+				lo[ix] = lo[m] + e;
+				changed = 1;
+			}
+			if(hi[m] - e > hi[ix])
+			{
+				hi[ix] = hi[m] - e;
+				changed = 1;
+			}
+		}
+	}
+
+	return changed;
+}
+
+/*****************************/
+int envelope_slopes(unsigned int size, Vertices* data)
+{
+	/* Gets a feasible surface for each connected region of slope constraints */
+	/* The gradient is taken over two perpendicular edges, so if each edge's height difference */
+	/* is within 1/sqrt(2) of the maximum slope, any gradient is within the maximum */
+	/* lo is the largest such surface below the heights, hi the smallest above them */
+	/* Both are found by sweeping back and forth until nothing changes */
+	/* Irregular regions, e.g. winding paths, may take a few more than 2 sweeps */
+	size_t n = (size_t)size * size;
+	float* lo = malloc((sizeof(float) * 2 + sizeof(unsigned int) + sizeof(unsigned char)) * n);
+
+	if(lo == NULL)
+	{
+		throw_error("Failed to allocate memory for slope envelopes.");
+		return 0;
+	}
+
+	float* hi = lo + n;
+	unsigned int* list = (unsigned int*)(hi + n);
+	unsigned char* seen = (unsigned char*)(list + n);
+
+	size_t i;
+	for(i = 0; i < n; ++i)
+	{
+		lo[i] = hi[i] = data->h[i];
+		seen[i] = 0;
+	}
+
+	float k = GET_SCALE(size) * sqrtf(.5f);
+	unsigned int sweeps = 0;
+	int changed = 1;
+
+	while(changed)
+	{
+		changed = sweep_envelopes(size, data, k, lo, hi, 1);
+		changed |= sweep_envelopes(size, data, k, lo, hi, 0);
+		sweeps += 2;
+	}
+
+	/* Halfway both envelopes satisfies the constraints just the same */
+	/* Then shift each region, so it holds as much material as before */
+	/* Only its border with the rest can be unsatisfied, that's left to relaxation */
+	unsigned int regions = 0;
+	for(i = 0; i < n; ++i)
+	{
+		if(!is_region(data, i) || seen[i])
+			continue;
+
+		/* Flood fill the region */
+		unsigned int count = 0, head = 0;
+		double diff = 0;
+		list[count++] = i;
+		seen[i] = 1;
+
+		while(head < count)
+		{
+			unsigned int ix = list[head++];
+			unsigned int c = ix / size;
+			unsigned int r = ix % size;
+			lo[ix] = .5f * (lo[ix] + hi[ix]);
+			diff += data->h[ix] - lo[ix];
+
+			unsigned int nb[4];
+			unsigned int num = 0;
+			if(c > 0)      nb[num++] = ix - size;
+			if(c < size-1) nb[num++] = ix + size;
+			if(r > 0)      nb[num++] = ix - 1;
+			if(r < size-1) nb[num++] = ix + 1;
+
+			while(num--)
+				if(is_region(data, nb[num]) && !seen[nb[num]])
+				{
+					seen[nb[num]] = 1;
+					list[count++] = nb[num];
+				}
+		}
+
+		float shift = diff / count;
+		while(count--)
+			data->h[list[count]] = lo[list[count]] + shift;
+
+		++regions;
+	}
+
+	output("Slope envelopes of %u regions took %u sweeps.", regions, sweeps);
+	free(lo);
+
+	return 1;
+}
@@ -3,16 +3,32 @@
 #include <string.h>
 
 /*****************************/
-int mod_flatten(unsigned int size, Vertex* data, ModData* mod)
+int mod_flatten(unsigned int size, Vertices* data, ModData* mod)
 {
 	/* Copy the center column to all other columns */
+	/* Do this for the heights, constraints and flags */
 	unsigned int mid = size >> 1;
-	unsigned int c;
+	unsigned int c, i;
 	for(c = 0; c < size; ++c)
-		if(c != mid) memcpy(
-			data + (c * size),
-			data + (mid * size),
-			sizeof(Vertex) * size);
+	{
+		if(c == mid)
+			continue;
+
+		memcpy(
+			data->h + (c * size),
+			data->h + (mid * size),
+			sizeof(float) * size);
+
+		for(i = 0; i < 3; ++i) memcpy(
+			data->c[i] + (c * size),
+			data->c[i] + (mid * size),
+			sizeof(float) * size);
+
+		memcpy(
+			data->flags + (c * size),
+			data->flags + (mid * size),
+			sizeof(unsigned char) * size);
+	}
 
 	/* We don't need to iterate this modifier */
 	mod->done = 1;
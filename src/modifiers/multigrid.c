@@ -0,0 +1,384 @@
+#include "constants.h"
+#include "modifiers.h"
+#include "output.h"
+#include "patch.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum number of levels, enough for a patch of 2^16+1 */
+#define MAX_LEVELS 16
+
+
+/* Multigrid hierarchy, level 0 being the patch itself */
+/* Each level has (size-1)/2+1 vertices, every other vertex of the finer level */
+/* It is a full approximation scheme: coarser levels relax the heights themselves */
+/* With a source term tau, what a sweep moves on a coarser level should equal it */
+/* Tau is chosen such that a solution of the finer level needs no correction at all */
+typedef struct
+{
+	unsigned int levels;
+	unsigned int sizes[MAX_LEVELS];
+	Vertices     data[MAX_LEVELS];
+	float*       saved[MAX_LEVELS]; /* Heights of a level before it was relaxed */
+	float*       tau[MAX_LEVELS];   /* Source term of a level, NULL for the patch itself */
+	float*       defect;            /* What a sweep moves, as large as the patch itself */
+
+} Hierarchy;
+
+
+/*****************************/
+static size_t get_hierarchy(
+	unsigned int size,
+	Vertices*    data,
+	ModData*     mod,
+	Hierarchy*   hier)
+{
+	/* First count the total number of coarse vertices */
+	size_t total = 0;
+
+	hier->levels = 1;
+	hier->sizes[0] = size;
+	hier->data[0] = *data;
+	hier->saved[0] = NULL;
+	hier->tau[0] = NULL;
+	hier->defect = NULL;
+
+	while(
+		hier->levels < MAX_LEVELS &&
+		hier->sizes[hier->levels-1] >= MG_MIN_SIZE * 2 - 1)
+	{
+		unsigned int l = hier->levels++;
+		hier->sizes[l] = (hier->sizes[l-1] - 1) / 2 + 1;
+		total += hier->sizes[l] * hier->sizes[l];
+	}
+
+	/* The coarser levels are stored one after the other in the modifier's buffer */
+	/* It holds 6 planes of total floats (h, c[3], saved, tau) */
+	/* Followed by the defect of the patch and the flags of the coarser levels */
+	if(mod->buffer != NULL)
+	{
+		size_t offset = 0;
+		size_t n = (size_t)size * size;
+		hier->defect = mod->buffer + total * 6;
+
+		unsigned int l;
+		for(l = 1; l < hier->levels; ++l)
+		{
+			Vertices* v = hier->data + l;
+			v->h = mod->buffer + offset;
+			v->c[0] = v->h + total;
+			v->c[1] = v->c[0] + total;
+			v->c[2] = v->c[1] + total;
+			v->flags = (unsigned char*)(hier->defect + n) + offset;
+			hier->saved[l] = v->c[2] + total;
+			hier->tau[l] = hier->saved[l] + total;
+
+			offset += hier->sizes[l] * hier->sizes[l];
+		}
+	}
+
+	return total;
+}
+
+/*****************************/
+static void restrict_constraints(
+	unsigned int fsize,
+	Vertices*    fine,
+	unsigned int csize,
+	Vertices*    coarse)
+{
+	/* Each coarse vertex takes the constraints of the fine vertex it sits on, as they are */
+	/* Slopes are per unit of distance, so they hold on any level */
+	/* Positions are left to the finest level, tau carries whatever they do */
+	unsigned int c, r, i;
+	for(c = 0; c < csize; ++c)
+		for(r = 0; r < csize; ++r)
+		{
+			unsigned int v = c * csize + r;
+			unsigned int s = (c*2) * fsize + r*2;
+
+			coarse->flags[v] = fine->flags[s] & ~POSITION;
+			for(i = 0; i < 3; ++i)
+				coarse->c[i][v] = fine->c[i][s];
+		}
+}
+
+/*****************************/
+static void restrict_values(
+	unsigned int fsize,
+	float*       fine,
+	unsigned int csize,
+	float*       coarse,
+	int          average)
+{
+	/* Full weighting of the 3x3 footprint, each fine vertex is spread over the coarse ones */
+	/* Heights are averaged, renormalized at the borders */
+	/* Defects are material, so they are summed and scaled to heights */
+	/* Every fine vertex then counts for exactly 1/4th, so their total is preserved */
+	unsigned int c, r;
+	for(c = 0; c < csize; ++c)
+		for(r = 0; r < csize; ++r)
+		{
+			float h = 0;
+			float w = 0;
+
+			int dc, dr;
+			for(dc = -1; dc <= 1; ++dc)
+				for(dr = -1; dr <= 1; ++dr)
+				{
+					int fc = (int)c*2 + dc;
+					int fr = (int)r*2 + dr;
+					if(fc < 0 || fc >= (int)fsize || fr < 0 || fr >= (int)fsize)
+						continue;
+
+					float fw = (dc ? .5f : 1) * (dr ? .5f : 1);
+					h += fw * fine[fc * fsize + fr];
+					w += fw;
+				}
+
+			coarse[c * csize + r] = h / (average ? w : 4);
+		}
+}
+
+/*****************************/
+static float get_spread(unsigned int csize, unsigned int ix)
+{
+	/* Interpolating spreads a coarse vertex over 2 fine ones per axis, 1.5 at the borders */
+	/* Its correction is scaled by 4 over both, so each hands out the same material */
+	unsigned int c = ix / csize;
+	unsigned int r = ix % csize;
+	float sc = (c == 0 || c == csize-1) ? 1.5f : 2;
+	float sr = (r == 0 || r == csize-1) ? 1.5f : 2;
+
+	return 4 / (sc * sr);
+}
+
+/*****************************/
+static void prolong_correction(
+	unsigned int fsize,
+	float*       fine,
+	unsigned int csize,
+	float*       coarse,
+	float*       saved)
+{
+	/* The correction is whatever relaxing the coarse level changed */
+	/* Bilinearly interpolate it to the fine level and add it */
+	/* Even fine vertices sit on a coarse one, odd ones in between two */
+	/* Coarse relaxation preserves the sum of the correction, so this preserves material :) */
+	unsigned int c, r;
+	for(c = 0; c < fsize; ++c)
+		for(r = 0; r < fsize; ++r)
+		{
+			unsigned int ix[4] = {
+				(c >> 1) * csize + (r >> 1),
+				(c >> 1) * csize + ((r+1) >> 1),
+				((c+1) >> 1) * csize + (r >> 1),
+				((c+1) >> 1) * csize + ((r+1) >> 1)
+			};
+
+			float e = 0;
+			unsigned int i;
+			for(i = 0; i < 4; ++i)
+				e += (coarse[ix[i]] - saved[ix[i]]) * get_spread(csize, ix[i]);
+
+			fine[c * fsize + r] += e * .25f;
+		}
+}
+
+/*****************************/
+static int sweep_level(
+	unsigned int size,
+	Vertices*    data,
+	float*       h,
+	float*       tau)
+{
+	float scale = GET_SCALE(size);
+	int done = 1;
+
+	/* A plain sequential sweep over h, the same as mod_relax does */
+	unsigned int ix;
+	for(ix = 0; ix < size*size; ++ix)
+		done &= relax_vertex(size, ix, scale, 1, data, h, h);
+
+	/* Again, position constraints are handled last */
+	for(ix = 0; ix < size*size; ++ix)
+		if(data->flags[ix] & POSITION)
+		{
+			done &= (h[ix] == data->c[2][ix]);
+			h[ix] = data->c[2][ix];
+		}
+
+	/* Then take the source term off */
+	if(tau)
+		for(ix = 0; ix < size*size; ++ix)
+			h[ix] -= tau[ix];
+
+	return done;
+}
+
+/*****************************/
+static int relax_level(
+	unsigned int  size,
+	Vertices*     data,
+	float*        tau,
+	unsigned int  sweeps,
+	unsigned int* iterations,
+	unsigned int  limit)
+{
+	/* With a source term nothing is ever done, it only settles */
+	int done = 0;
+
+	unsigned int i;
+	for(i = 0; i < sweeps; ++i)
+	{
+		/* Never sweep the patch itself beyond the limit */
+		if(iterations)
+		{
+			if(*iterations >= limit) break;
+			++(*iterations);
+		}
+
+		done = sweep_level(size, data, data->h, tau) && !tau;
+		if(done) break;
+	}
+
+	return done;
+}
+
+/*****************************/
+static void get_defect(
+	unsigned int size,
+	Vertices*    data,
+	float*       tau,
+	float*       defect)
+{
+	/* What a sweep would move, on a copy of the heights */
+	memcpy(defect, data->h, sizeof(float) * size * size);
+	sweep_level(size, data, defect, tau);
+
+	unsigned int ix;
+	for(ix = 0; ix < size*size; ++ix)
+		defect[ix] -= data->h[ix];
+}
+
+/*****************************/
+static int vcycle(
+	Hierarchy*    hier,
+	unsigned int  l,
+	unsigned int* iterations,
+	unsigned int  limit)
+{
+	unsigned int size = hier->sizes[l];
+	Vertices* data = hier->data + l;
+	float* tau = hier->tau[l];
+
+	/* On the coarsest level, just relax */
+	if(l == hier->levels-1)
+		return relax_level(size, data, tau, MG_COARSE_ITERATIONS, iterations, limit);
+
+	/* Smooth first, if that converged there is nothing left to correct */
+	if(relax_level(size, data, tau, MG_SMOOTH, iterations, limit))
+		return 1;
+
+	/* Move the heights to the coarser level and remember them */
+	unsigned int csize = hier->sizes[l+1];
+	Vertices* coarse = hier->data + (l+1);
+	float* saved = hier->saved[l+1];
+	float* ctau = hier->tau[l+1];
+
+	restrict_values(size, data->h, csize, coarse->h, 1);
+	memcpy(saved, coarse->h, sizeof(float) * csize * csize);
+
+	/* The coarse source term is what a coarse sweep moves of those heights */
+	/* Minus what a sweep moves here (on top of this level's tau), restricted */
+	/* So if nothing moves here, the restricted heights are what relaxing the coarse level gives */
+	/* Getting the defect is a sweep as well, count it */
+	/* If there is nothing left to sweep, the correction waits for the next V-cycle */
+	if(iterations)
+	{
+		if(*iterations >= limit) return 0;
+		++(*iterations);
+	}
+
+	get_defect(size, data, tau, hier->defect);
+	restrict_values(size, hier->defect, csize, ctau, 0);
+	get_defect(csize, coarse, NULL, hier->defect);
+
+	unsigned int ix;
+	for(ix = 0; ix < csize * csize; ++ix)
+		ctau[ix] = hier->defect[ix] - ctau[ix];
+
+	/* Relax the coarser level and bring its correction back up */
+	/* Only iterations of the patch itself are counted */
+	vcycle(hier, l+1, NULL, 0);
+	prolong_correction(size, data->h, csize, coarse->h, saved);
+
+	/* And smooth out whatever the interpolation did */
+	return relax_level(size, data, tau, MG_SMOOTH, iterations, limit);
+}
+
+/*****************************/
+int mod_relax_multigrid(unsigned int size, Vertices* data, ModData* mod)
+{
+	/* Check if it is in the form 2^N+1 */
+	if(((size-1) & (size-2)) != 0)
+	{
+		throw_error("Multigrid relaxation expects a square grid with a width and height of 2^N+1.");
+		return 0;
+	}
+
+	/* Allocate all coarser levels if they weren't there yet */
+	Hierarchy hier;
+	size_t coarseSize = get_hierarchy(size, data, mod, &hier);
+
+	if(coarseSize > 0 && mod->buffer == NULL)
+	{
+		mod->buffer = malloc(
+			(sizeof(float) * 6 + sizeof(unsigned char)) * coarseSize +
+			sizeof(float) * size * size);
+
+		if(mod->buffer == NULL)
+		{
+			throw_error("Failed to allocate memory for multigrid levels.");
+			return 0;
+		}
+
+		get_hierarchy(size, data, mod, &hier);
+
+		/* Constraints don't change while relaxing, so restrict them right away */
+		unsigned int l;
+		for(l = 1; l < hier.levels; ++l)
+			restrict_constraints(
+				hier.sizes[l-1], hier.data + (l-1), hier.sizes[l], hier.data + l);
+	}
+
+	/* Run V-cycles until this step's worth of iterations is done */
+	/* Sweeps are clamped to what is left of the step and of MAX_ITERATIONS */
+	unsigned int steps = (mod->steps > 0) ? mod->steps : STEP_SIZE;
+	unsigned int start = mod->iterations;
+	unsigned int limit = start + steps;
+	if(limit > MAX_ITERATIONS) limit = MAX_ITERATIONS;
+
+	do
+	{
+		TRACE_BEGIN(vcycle);
+		int done = vcycle(&hier, 0, &mod->iterations, limit);
+		TRACE_END(vcycle, "vcycle");
+
+		/* Exit if no changes were made */
+		/* Or when the maximum number of iterations ended */
+		if(done || mod->iterations >= MAX_ITERATIONS)
+		{
+			finish_relax(mod, done);
+			return 1;
+		}
+	}
+	while(mod->iterations < limit);
+
+	/* Output where we are, every time we pass a multiple of ITER_PRINT */
+	if(start / ITER_PRINT != mod->iterations / ITER_PRINT)
+		output("%u iterations...", mod->iterations);
+
+	return 1;
+}
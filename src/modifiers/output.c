@@ -1,62 +1,186 @@
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "constants.h"
 #include "output.h"
 #include "patch.h"
+#include "pool.h"
+#include "trace.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+/* Number of columns formatted by a single task */
+#define OUTPUT_COLUMNS 16
+
+
+/* Printer of a single vertex */
+typedef void (*VertexPrinter)(FILE*, int, Vertices*, unsigned int);
+
+
+/* A terrain being written */
+typedef struct
+{
+	unsigned int  size;
+	Vertices*     data;
+	VertexPrinter printer;
+	FILE*         file;
+	int           failed;
+
+} TerrainOutput;
+
+
+/* A number of columns of a terrain being written, formatted in memory first */
+typedef struct
+{
+	TerrainOutput* out;
+	unsigned int   index;
+	char*          text;
+	size_t         length;
+	unsigned int   deps[2]; /* Its formatting and the chunk before it */
+
+} TerrainChunk;
 
 /*****************************/
-static void print_height(FILE* f, int comma, Vertex* v)
+static void print_height(FILE* f, int comma, Vertices* data, unsigned int i)
 {
-	fprintf(f, !comma ? "%f " : "%f, ", v->h);
+	fprintf(f, !comma ? "%f " : "%f, ", data->h[i]);
 }
 
 /*****************************/
-static void print_flags(FILE* f, int comma, Vertex* v)
+static void print_flags(FILE* f, int comma, Vertices* data, unsigned int i)
 {
-	fprintf(f, !comma ? "%i " : "%i, ", v->flags);
+	fprintf(f, !comma ? "%i " : "%i, ", data->flags[i]);
 }
 
 /*****************************/
-static void print_constrs(FILE* f, int comma, Vertex* v)
+static void print_constrs(FILE* f, int comma, Vertices* data, unsigned int i)
 {
-	fprintf(f, !comma ? "[%f,%f,%f] " : "[%f,%f,%f], ", v->c[0], v->c[1], v->c[2]);
+	fprintf(f, !comma ? "[%f,%f,%f] " : "[%f,%f,%f], ",
+		data->c[0][i], data->c[1][i], data->c[2][i]);
 }
 
 /*****************************/
-static int output_terrain(
-	unsigned int size,
-	Vertex*      data,
-	void       (*printer)(FILE*, int, Vertex*),
-	const char*  file)
+static void format_chunk(unsigned int i, void* data)
 {
-	/* Open the file */
-	FILE* f = fopen(file, "w");
+	TerrainChunk* chunk = data;
+	TerrainOutput* out = chunk->out;
+
+	FILE* f = open_memstream(&chunk->text, &chunk->length);
 	if(f == NULL)
 	{
-		throw_error("Could not open file: %s", file);
-		return 0;
+		chunk->text = NULL;
+		return;
 	}
 
-	/* Output the terrain to the file */
-	/* We output it as a matrix, so [ [...],[...],...,[...] ] */
-	/* Note this is just a JSON array :) */
-	fputs("[\n", f);
-
 	/* The output is column-major */
 	/* In practice this means the first row is actually the first column of the terrain */
+	unsigned int size = out->size;
 	unsigned int c, r;
-	for(c = 0; c < size; ++c)
+	for(c = chunk->index * OUTPUT_COLUMNS; c < (chunk->index+1) * OUTPUT_COLUMNS && c < size; ++c)
 	{
 		fputs("[ ", f);
 
 		for(r = 0; r < size; ++r)
-			printer(f, r < size-1, data + (c * size + r));
+			out->printer(f, r < size-1, out->data, c * size + r);
 
 		fputs(c == size-1 ? "]\n" : "],\n", f);
 	}
 
-	fputs("]", f);
 	fclose(f);
+}
+
+/*****************************/
+static void write_chunk(unsigned int i, void* data)
+{
+	/* Chunks are written in order, each as soon as it and the one before are done */
+	TerrainChunk* chunk = data;
+
+	if(chunk->text == NULL)
+		chunk->out->failed = 1;
+	else
+	{
+		fwrite(chunk->text, 1, chunk->length, chunk->out->file);
+		free(chunk->text);
+	}
+}
+
+/*****************************/
+static int output_terrain(
+	unsigned int  size,
+	Vertices*     data,
+	VertexPrinter printer,
+	const char*   file)
+{
+	/* Every chunk of columns is formatted and then written, as a task graph */
+	/* Nodes 2i format chunk i, nodes 2i+1 write it */
+	unsigned int chunks = (size + OUTPUT_COLUMNS - 1) / OUTPUT_COLUMNS;
+	TerrainChunk* ch = malloc(sizeof(TerrainChunk) * chunks);
+	PoolNode* nodes = malloc(sizeof(PoolNode) * chunks * 2);
+
+	if(ch == NULL || nodes == NULL)
+	{
+		throw_error("Failed to allocate memory to output a terrain.");
+		free(ch);
+		free(nodes);
+		return 0;
+	}
+
+	/* Open the file */
+	TRACE_BEGIN(write);
+	TerrainOutput out = {
+		.size    = size,
+		.data    = data,
+		.printer = printer,
+		.file    = fopen(file, "w"),
+		.failed  = 0
+	};
+
+	if(out.file == NULL)
+	{
+		throw_error("Could not open file: %s", file);
+		free(ch);
+		free(nodes);
+		return 0;
+	}
+
+	unsigned int i;
+	for(i = 0; i < chunks; ++i)
+	{
+		ch[i].out = &out;
+		ch[i].index = i;
+		ch[i].deps[0] = i * 2;
+		ch[i].deps[1] = (i > 0) ? i * 2 - 1 : 0;
+
+		nodes[i*2].count = 1;
+		nodes[i*2].task = format_chunk;
+		nodes[i*2].data = ch + i;
+		nodes[i*2].deps = NULL;
+		nodes[i*2].num_deps = 0;
+
+		nodes[i*2+1].count = 1;
+		nodes[i*2+1].task = write_chunk;
+		nodes[i*2+1].data = ch + i;
+		nodes[i*2+1].deps = ch[i].deps;
+		nodes[i*2+1].num_deps = (i > 0) ? 2 : 1;
+	}
+
+	/* Output the terrain to the file */
+	/* We output it as a matrix, so [ [...],[...],...,[...] ] */
+	/* Note this is just a JSON array :) */
+	fputs("[\n", out.file);
+	pool_graph(chunks * 2, nodes);
+	fputs("]", out.file);
+	fclose(out.file);
+	TRACE_END(write, "write_terrain");
+
+	free(ch);
+	free(nodes);
+
+	if(out.failed)
+	{
+		throw_error("Could not format terrain for file: %s", file);
+		return 0;
+	}
 
 	/* Print that the terrain has been written to the file correctly */
 	output("Terrain has been written to file: %s", file);
@@ -65,7 +189,7 @@ static int output_terrain(
 }
 
 /*****************************/
-int mod_output(unsigned int size, Vertex* data, ModData* mod)
+int mod_output(unsigned int size, Vertices* data, ModData* mod)
 {
 	if(!mod->out)
 		throw_error("No output file was given to the output modifier.");
@@ -76,7 +200,7 @@ int mod_output(unsigned int size, Vertex* data, ModData* mod)
 }
 
 /*****************************/
-int mod_output_flags(unsigned int size, Vertex* data, ModData* mod)
+int mod_output_flags(unsigned int size, Vertices* data, ModData* mod)
 {
 	if(!mod->out)
 		throw_error("No output file was given to the flag output modifier.");
@@ -86,7 +210,7 @@ int mod_output_flags(unsigned int size, Vertex* data, ModData* mod)
 }
 
 /*****************************/
-int mod_output_constrs(unsigned int size, Vertex* data, ModData* mod)
+int mod_output_constrs(unsigned int size, Vertices* data, ModData* mod)
 {
 	if(!mod->out)
 		throw_error("No output file was given to the constraint output modifier.");
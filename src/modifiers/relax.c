@@ -1,33 +1,115 @@
 
 #include "constants.h"
+#include "modifiers.h"
 #include "output.h"
+#include "perf.h"
 #include "patch.h"
+#include "pool.h"
+#include "timer.h"
+#include "trace.h"
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* Check if two indices are on the same column */
 #define SAME_COLUMN(i,j,size) (((i)/size) == ((j)/size))
 
+/* Number of colours of a multi-coloured sweep */
+/* Vertices of the same colour never touch each other's neighbourhood */
+/* The slope constraints touch the 4 cardinal neighbours, so 5 colours do */
+/* Roughness touches the whole 3x3 neighbourhood, so that needs 9 colours */
+#define COLORS (USE_ROUGHNESS ? 9 : 5)
+
+
+/* Worklist of an active set relaxation */
+/* Only vertices in the worklist are relaxed, all others are known to be satisfied */
+/* Allocated as one block, the arrays follow the struct itself */
+typedef struct
+{
+	unsigned int   count;  /* Vertices in list */
+	unsigned int   queued; /* Vertices in next */
+	unsigned int*  list;   /* Vertices to relax this iteration */
+	unsigned int*  next;   /* Vertices to relax next iteration */
+	unsigned char* marks;  /* Non-zero if a vertex is in next */
+
+} ActiveSet;
+
+
+/* State of Chebyshev acceleration, kept in the relaxation buffer between calls */
+/* The factors only hold while the same constraints are active, i.e. while it's linear */
+/* So whenever the sweep moves a different number of vertices, they start over */
+typedef struct
+{
+	unsigned int start;  /* Iteration the factors last started over at */
+	unsigned int base;   /* Vertices the first sweep since then moved */
+	unsigned int moving; /* Vertices the last sweep moved */
+	float        change; /* Squared length of the last sweep's moves */
+	float        rho;    /* Spectral radius of a sweep, as estimated */
+	float        omega;  /* Extrapolation factor of the last iteration */
+	int          swapped; /* Non-zero if the heights and the previous iteration swapped places */
+
+} Chebyshev;
+
+
+/* A parallel relaxation sweep */
+/* The columns are split into strips that are relaxed on different threads */
+/* A strip writes to the columns adjacent to it, so all even strips are relaxed first */
+/* Then all odd strips, as long as each strip is at least 2 columns wide they never overlap */
+typedef struct
+{
+	unsigned int   size;
+	float          scale;
+	float          weight;
+	Vertices*      data;
+	Constraints*   cons;
+	float*         inp;
+	float*         out;
+
+	unsigned int   strips;
+	unsigned int   phase; /* Strips to relax, 0 = even, 1 = odd */
+	unsigned int   color; /* Colour to relax if multi-coloured */
+	int*           done;  /* Done flag of each strip */
+	unsigned char* moved; /* Non-zero for each column that moved something, can be NULL */
+	float*         prev;  /* Heights of the previous iteration if Chebyshev accelerated */
+	float          omega; /* Chebyshev extrapolation factor */
+	unsigned int*  moving; /* Vertices the sweep moved in each strip, if accelerated */
+	double*        change; /* Squared length of those moves in each strip, if accelerated */
+
+} RelaxSweep;
+
+
+/* Columns to copy from src to dst, around each column that moved */
+typedef struct
+{
+	unsigned int   size;
+	float*         dst;
+	float*         src;
+	unsigned char* moved;
+
+} SyncColumns;
+
+
 /*****************************/
 static void move_slope(
-	float   slope,
-	float   scale,
-	Vertex* o1,
-	Vertex* o2,
-	float   maxSlope,
-	float   weight)
-{
-	/* The current slope and the indices */
+	float  slope,
+	float  scale,
+	float* o1,
+	float* o2,
+	float  maxSlope,
+	float  weight)
+{
+	/* The current slope and the heights */
 	/* a is the lowest point, b the highest */
-	Vertex* b = (slope > 0) ? o2 : o1;
-	Vertex* a = (slope > 0) ? o1 : o2;
+	float* b = (slope > 0) ? o2 : o1;
+	float* a = (slope > 0) ? o1 : o2;
 
 	/* Move a and b closer to each other until the slope is satisfied */
 	float move = (fabs(slope) - maxSlope) * scale * (.5f * weight);
-	a->h += move;
-	b->h -= move;
+	*a += move;
+	*b -= move;
 }
 
 /*****************************/
@@ -62,10 +144,11 @@ int get_neighbours(
 static int relax_slope(
 	unsigned int size,
 	unsigned int ix,
+	float        maxSlope,
 	float        scale,
 	float        weight,
-	Vertex*      inp,
-	Vertex*      out)
+	float*       inp,
+	float*       out)
 {
 	int done = 1;
 
@@ -80,15 +163,15 @@ static int relax_slope(
 			continue;
 
 		/* This scales gradient vector g by MaxSlope/|g| */
-		float sx = (inp[ixx].h - inp[ix].h) / scale;
-		float sy = (inp[ixy].h - inp[ix].h) / scale;
+		float sx = (inp[ixx] - inp[ix]) / scale;
+		float sy = (inp[ixy] - inp[ix]) / scale;
 		float g = hypotf(sx, sy);
 
 		/* And add the oh so familiar convergence threshold to the comparison */
 		/* Again for floating point errors */
-		if(g > inp[ix].c[0] + S_THRESHOLD)
+		if(g > maxSlope + S_THRESHOLD)
 		{
-			g = inp[ix].c[0] / g;
+			g = maxSlope / g;
 			move_slope(sx, scale, out + ix, out + ixx, fabs(sx) * g, weight);
 			move_slope(sy, scale, out + ix, out + ixy, fabs(sy) * g, weight);
 
@@ -104,10 +187,13 @@ static int relax_slope(
 static int relax_dir_slope(
 	unsigned int size,
 	unsigned int ix,
+	float        dx,
+	float        dy,
+	float        maxSlope,
 	float        scale,
 	float        weight,
-	Vertex*      inp,
-	Vertex*      out)
+	float*       inp,
+	float*       out)
 {
 	int done = 1;
 
@@ -121,11 +207,8 @@ static int relax_dir_slope(
 			continue;
 
 		/* This scales directional derivative d by MaxSlope/d */
-		float maxSlope = hypotf(inp[ix].c[0], inp[ix].c[1]);
-		float dx = inp[ix].c[0] / maxSlope;
-		float dy = inp[ix].c[1] / maxSlope;
-		float sx = (inp[ixx].h - inp[ix].h) / scale;
-		float sy = (inp[ixy].h - inp[ix].h) / scale;
+		float sx = (inp[ixx] - inp[ix]) / scale;
+		float sy = (inp[ixy] - inp[ix]) / scale;
 		float d = fabs(sx * dx + sy * dy);
 
 		/* The familiar convergence threshold */
@@ -146,7 +229,7 @@ static int relax_dir_slope(
 /*****************************/
 float calc_roughness(
 	unsigned int size,
-	Vertex*      data,
+	float*       h,
 	unsigned int ix,
 	float        scale)
 {
@@ -169,7 +252,7 @@ float calc_roughness(
 			/* Suuuuuuuuuuuuuuuum */
 			/* Note we divide by scale to get slope */
 			/* This is so this metric is scale invariant */
-			float s = (data[ixx].h - data[ix].h) / scale;
+			float s = (h[ixx] - h[ix]) / scale;
 			R += s*s;
 		}
 
@@ -180,19 +263,20 @@ float calc_roughness(
 static int relax_roughness(
 	unsigned int size,
 	unsigned int ix,
+	float        roughness,
 	float        scale,
 	float        weight,
-	Vertex*      inp,
-	Vertex*      out)
+	float*       inp,
+	float*       out)
 {
 	/* Calculate current roughness and check for the threshold */
 	/* Without this threshold the whole landscape goes mad :( */
 	float R = calc_roughness(size, inp, ix, scale);
-	if(fabs(R - inp[ix].c[0]) <= R_THRESHOLD)
+	if(fabs(R - roughness) <= R_THRESHOLD)
 		return 1;
 
 	/* Get the factor to correct the current roughness to the desired one */
-	R = inp[ix].c[0] / R;
+	R = roughness / R;
 
 	/* Smth to store the move values in */
 	float move[9] = {0};
@@ -219,7 +303,7 @@ static int relax_roughness(
 
 			/* We actually calculate what we want to move as if the point is 1 unit away */
 			/* This so it all is scale invariant */
-			float s = (inp[ixx].h - inp[ix].h) / scale;
+			float s = (inp[ixx] - inp[ix]) / scale;
 			move[im] = s * R - s;
 			dSupp += move[im];
 		}
@@ -240,7 +324,7 @@ static int relax_roughness(
 
 			/* Obviously apply the weight as well */
 			float m = (move[(c+1)*3+(r+1)] - dSupp) * scale;
-			out[ixx].h += m * weight;
+			out[ixx] += m * weight;
 		}
 
 	/* Well we modified something, so return 0 */
@@ -248,13 +332,740 @@ static int relax_roughness(
 }
 
 /*****************************/
-int mod_relax_slope_1d(unsigned int size, Vertex* data, ModData* mod)
+int relax_vertex(
+	unsigned int size,
+	unsigned int ix,
+	float        scale,
+	float        weight,
+	Vertices*    data,
+	float*       inp,
+	float*       out)
 {
-	float scale = GET_SCALE(size);
+	int done = 1;
 
-	/* Only modify the center column */
-	Vertex* mid = data + ((size >> 1) * size);
+	/* Apply the relevant constraints */
+	unsigned char flags = data->flags[ix];
+	if(flags & SLOPE)
+		done &= relax_slope(
+			size, ix, data->c[0][ix], scale, weight, inp, out);
+
+	if(flags & DIR_SLOPE)
+	{
+		float maxSlope = hypotf(data->c[0][ix], data->c[1][ix]);
+		done &= relax_dir_slope(
+			size, ix,
+			data->c[0][ix] / maxSlope, data->c[1][ix] / maxSlope, maxSlope,
+			scale, weight, inp, out);
+	}
+
+	if(flags & ROUGHNESS)
+		done &= relax_roughness(
+			size, ix, data->c[0][ix], scale, weight, inp, out);
+
+	return done;
+}
+
+/*****************************/
+static int relax_slope_list(
+	unsigned int    size,
+	ConstraintList* list,
+	unsigned int    begin,
+	unsigned int    end,
+	float           scale,
+	float           weight,
+	float*          inp,
+	float*          out)
+{
+	int done = 1;
+
+	unsigned int i;
+	for(i = begin; i < end; ++i)
+		done &= relax_slope(
+			size, list->ix[i], list->p[0][i], scale, weight, inp, out);
+
+	return done;
+}
+
+/*****************************/
+static int relax_dir_slope_list(
+	unsigned int    size,
+	ConstraintList* list,
+	unsigned int    begin,
+	unsigned int    end,
+	float           scale,
+	float           weight,
+	float*          inp,
+	float*          out)
+{
+	int done = 1;
+
+	unsigned int i;
+	for(i = begin; i < end; ++i)
+		done &= relax_dir_slope(
+			size, list->ix[i], list->p[0][i], list->p[1][i], list->p[2][i],
+			scale, weight, inp, out);
+
+	return done;
+}
+
+/*****************************/
+static int relax_roughness_list(
+	unsigned int    size,
+	ConstraintList* list,
+	unsigned int    begin,
+	unsigned int    end,
+	float           scale,
+	float           weight,
+	float*          inp,
+	float*          out)
+{
+	int done = 1;
+
+	unsigned int i;
+	for(i = begin; i < end; ++i)
+		done &= relax_roughness(
+			size, list->ix[i], list->p[0][i], scale, weight, inp, out);
+
+	return done;
+}
+
+/*****************************/
+static int relax_column_in_order(
+	unsigned int size,
+	unsigned int c,
+	float        scale,
+	float        weight,
+	Constraints* cons,
+	float*       inp,
+	float*       out)
+{
+	int done = 1;
+
+	/* Walk all lists of the column at once, always taking the lowest vertex index */
+	/* This so vertices are relaxed in the same order as the vertices themselves */
+	/* Which matters when relaxing in-place, each vertex sees the moves of the ones before */
+	unsigned int s = cons->slope.offsets[c];
+	unsigned int d = cons->dir_slope.offsets[c];
+	unsigned int r = cons->roughness.offsets[c];
+	unsigned int se = cons->slope.offsets[c+1];
+	unsigned int de = cons->dir_slope.offsets[c+1];
+	unsigned int re = cons->roughness.offsets[c+1];
+
+	while(s < se || d < de || r < re)
+	{
+		unsigned int is = (s < se) ? cons->slope.ix[s] : UINT_MAX;
+		unsigned int id = (d < de) ? cons->dir_slope.ix[d] : UINT_MAX;
+		unsigned int ir = (r < re) ? cons->roughness.ix[r] : UINT_MAX;
+
+		if(is <= id && is <= ir)
+		{
+			done &= relax_slope(
+				size, is, cons->slope.p[0][s], scale, weight, inp, out);
+			++s;
+		}
+		else if(id <= ir)
+		{
+			done &= relax_dir_slope(
+				size, id,
+				cons->dir_slope.p[0][d], cons->dir_slope.p[1][d], cons->dir_slope.p[2][d],
+				scale, weight, inp, out);
+			++d;
+		}
+		else
+		{
+			done &= relax_roughness(
+				size, ir, cons->roughness.p[0][r], scale, weight, inp, out);
+			++r;
+		}
+	}
+
+	return done;
+}
+
+/*****************************/
+static void skip_rows(
+	ConstraintList* list,
+	unsigned int    c,
+	unsigned int    first,
+	unsigned int    last,
+	unsigned int*   skipBegin,
+	unsigned int*   skipEnd)
+{
+	/* Find the entries of column c with a vertex index in [first, last] */
+	/* Entries are sorted, so only walk in from both ends */
+	unsigned int b = list->offsets[c];
+	unsigned int e = list->offsets[c+1];
+
+	while(b < e && list->ix[b] < first) ++b;
+	while(e > b && list->ix[e-1] > last) --e;
+
+	*skipBegin = b;
+	*skipEnd = e;
+}
+
+/*****************************/
+static int relax_columns(
+	unsigned int size,
+	unsigned int begin,
+	unsigned int end,
+	float        scale,
+	float        weight,
+	Vertices*    data,
+	Constraints* cons,
+	float*       inp,
+	float*       out)
+{
+	int done = 1;
+
+	/* Loop over the compiled constraints of each column */
+	/* When not relaxing in-place the order doesn't matter, so do one type at a time */
+	unsigned int c;
+	for(c = begin; c < end; ++c)
+	{
+		if(inp == out)
+		{
+			done &= relax_column_in_order(size, c, scale, weight, cons, inp, out);
+			continue;
+		}
+
+		/* If not relaxing in-place, the interior can be done a vector of rows at a time */
+		/* Skip the slope entries it did, what's left is done one vertex at a time */
+		unsigned int rows = 0;
+		if(USE_SIMD && inp != out && c > 0 && c < size-1)
+			done &= relax_column_simd(size, c, scale, weight, data, inp, out, &rows);
+
+		unsigned int sb = cons->slope.offsets[c+1];
+		unsigned int se = sb;
+		unsigned int db = cons->dir_slope.offsets[c+1];
+		unsigned int de = db;
+
+		if(rows > 0)
+		{
+			skip_rows(&cons->slope, c, c * size + 1, c * size + rows, &sb, &se);
+			skip_rows(&cons->dir_slope, c, c * size + 1, c * size + rows, &db, &de);
+		}
+
+		done &= relax_slope_list(
+			size, &cons->slope, cons->slope.offsets[c], sb, scale, weight, inp, out);
+		done &= relax_slope_list(
+			size, &cons->slope, se, cons->slope.offsets[c+1], scale, weight, inp, out);
+
+		done &= relax_dir_slope_list(
+			size, &cons->dir_slope, cons->dir_slope.offsets[c], db, scale, weight, inp, out);
+		done &= relax_dir_slope_list(
+			size, &cons->dir_slope, de, cons->dir_slope.offsets[c+1], scale, weight, inp, out);
+
+		done &= relax_roughness_list(
+			size, &cons->roughness,
+			cons->roughness.offsets[c], cons->roughness.offsets[c+1],
+			scale, weight, inp, out);
+	}
+
+	return done;
+}
+
+/*****************************/
+static int relax_color(
+	unsigned int size,
+	unsigned int begin,
+	unsigned int end,
+	unsigned int color,
+	float        scale,
+	float        weight,
+	Vertices*    data,
+	float*       inp,
+	float*       out)
+{
+	int done = 1;
+
+	/* Loop over all vertices of the given colour in the columns */
+	/* With 9 colours, the colour is (c mod 3) * 3 + (r mod 3) */
+	/* With 5 colours, the colour is (c + 2r) mod 5, so r = 3(color - c) mod 5 */
+	unsigned int c, r;
+	for(c = begin; c < end; ++c)
+	{
+		if(COLORS == 9 && c % 3 != color / 3)
+			continue;
+
+		unsigned int first = (COLORS == 9) ?
+			color % 3 : (3 * ((color + 5 - c % 5) % 5)) % 5;
+
+		for(r = first; r < size; r += (COLORS == 9) ? 3 : 5)
+			done &= relax_vertex(size, c * size + r, scale, weight, data, inp, out);
+	}
+
+	return done;
+}
+
+/*****************************/
+static int relax_position(
+	unsigned int size,
+	unsigned int begin,
+	unsigned int end,
+	Constraints* cons,
+	float*       out)
+{
+	int done = 1;
+
+	/* This overrides the height of a vertex completely */
+	/* All entries of the columns are next to each other */
+	ConstraintList* list = &cons->position;
+	unsigned int i;
+	for(i = list->offsets[begin]; i < list->offsets[end]; ++i)
+	{
+		done &= (out[list->ix[i]] == list->p[0][i]);
+		out[list->ix[i]] = list->p[0][i];
+	}
+
+	return done;
+}
+
+/*****************************/
+static void relax_strip(unsigned int i, void* data)
+{
+	RelaxSweep* sweep = data;
+	unsigned int s = i * 2 + sweep->phase;
+
+	/* Relax column by column to know which ones moved */
+	unsigned int c;
+	for(c = s * sweep->size / sweep->strips; c < (s+1) * sweep->size / sweep->strips; ++c)
+	{
+		int done = relax_columns(
+			sweep->size,
+			c,
+			c+1,
+			sweep->scale,
+			sweep->weight,
+			sweep->data,
+			sweep->cons,
+			sweep->inp,
+			sweep->out);
+
+		sweep->moved[c] |= !done;
+		sweep->done[s] &= done;
+	}
+}
+
+/*****************************/
+static void relax_color_strip(unsigned int s, void* data)
+{
+	RelaxSweep* sweep = data;
+
+	sweep->done[s] &= relax_color(
+		sweep->size,
+		s * sweep->size / sweep->strips,
+		(s+1) * sweep->size / sweep->strips,
+		sweep->color,
+		sweep->scale,
+		sweep->weight,
+		sweep->data,
+		sweep->inp,
+		sweep->out);
+}
+
+/*****************************/
+static void relax_position_strip(unsigned int s, void* data)
+{
+	RelaxSweep* sweep = data;
+
+	unsigned int c;
+	for(c = s * sweep->size / sweep->strips; c < (s+1) * sweep->size / sweep->strips; ++c)
+	{
+		int done = relax_position(sweep->size, c, c+1, sweep->cons, sweep->out);
+
+		if(sweep->moved)
+			sweep->moved[c] |= !done;
+		sweep->done[s] &= done;
+	}
+}
+
+/*****************************/
+static void extrapolate_strip(unsigned int s, void* data)
+{
+	RelaxSweep* sweep = data;
+	unsigned int begin = s * sweep->size / sweep->strips * sweep->size;
+	unsigned int end = (s+1) * sweep->size / sweep->strips * sweep->size;
+
+	/* Chebyshev: x(k+1) = x(k-1) + omega * (sweep(x(k)) - x(k-1)) */
+	/* Written as a correction of sweep(x(k)), which rounds a lot better */
+	/* Both sweep(x(k)) and x(k-1) hold the same material, so this preserves it :) */
+	/* Up to rounding that is, which later extrapolations keep amplifying */
+	/* So the rounding error of each vertex is carried over to the next one */
+	/* The result goes to the previous buffer, which then becomes the input */
+	/* And to the output buffer, so the next sweep starts off equal to its input */
+	/* Meanwhile count what the sweep itself moved, to know when to start over */
+	double err = 0;
+	double change = 0;
+	unsigned int moving = 0;
+	unsigned int ix;
+	for(ix = begin; ix < end; ++ix)
+	{
+		float d = sweep->out[ix] - sweep->inp[ix];
+		moving += (d != 0);
+		change += (double)d * d;
+
+		double x = err + sweep->out[ix] +
+			(double)(sweep->omega - 1) * (sweep->out[ix] - sweep->prev[ix]);
+
+		float h = (float)x;
+		err = x - h;
+
+		sweep->prev[ix] = h;
+		sweep->out[ix] = h;
+	}
+
+	sweep->moving[s] = moving;
+	sweep->change[s] = change;
+}
+
+/*****************************/
+static int relax_parallel(
+	unsigned int   size,
+	float          scale,
+	float          weight,
+	Vertices*      data,
+	Constraints*   cons,
+	float*         inp,
+	float*         out,
+	unsigned char* moved,
+	float*         prev,
+	Chebyshev*     cheb)
+{
+	/* Strips of a fixed width, the order of all updates follows from them */
+	/* Both within a strip and where strips meet, as all even strips go first */
+	/* So the result is the same on any number of threads, which only pick up strips */
+	/* Each strip must be at least 2 columns wide */
+	unsigned int strips = size / STRIP_COLUMNS;
+	if(strips < 1)
+		strips = 1;
+
+	int done[strips];
+	unsigned int moving[strips];
+	double change[strips];
+	RelaxSweep sweep = {
+		.size   = size,
+		.scale  = scale,
+		.weight = weight,
+		.data   = data,
+		.cons   = cons,
+		.inp    = inp,
+		.out    = out,
+		.strips = strips,
+		.phase  = 0,
+		.color  = 0,
+		.done   = done,
+		.moved  = moved,
+		.prev   = prev,
+		.omega  = 1,
+		.moving = moving,
+		.change = change
+	};
+
+	unsigned int s;
+	for(s = 0; s < strips; ++s)
+		done[s] = 1;
+
+	memset(moved, 0, size);
+
+	/* Relax all even strips, then all odd strips */
+	PERF_BEGIN(PERF_SWEEP);
+	pool_run((strips + 1) / 2, relax_strip, &sweep);
+	sweep.phase = 1;
+	pool_run(strips / 2, relax_strip, &sweep);
+	PERF_END(PERF_SWEEP);
+
+	/* If accelerated, extrapolate back into the input */
+	/* Unless nothing moved, then the sweep is all there is */
+	if(prev)
+	{
+		int d = 1;
+		for(s = 0; s < strips; ++s)
+			d &= done[s];
+
+		sweep.omega = d ? 1 : cheb->omega;
+		pool_run(strips, extrapolate_strip, &sweep);
+
+		double total = 0;
+		cheb->moving = 0;
+		for(s = 0; s < strips; ++s)
+		{
+			cheb->moving += moving[s];
+			total += change[s];
+		}
+
+		cheb->change = (float)total;
+	}
+
+	/* Position constraints only touch their own vertex */
+	/* If accelerated, both the new iteration and the next output need them */
+	PERF_BEGIN(PERF_POSITION);
+	pool_run(strips, relax_position_strip, &sweep);
+	if(prev)
+	{
+		sweep.out = prev;
+		pool_run(strips, relax_position_strip, &sweep);
+	}
+	PERF_END(PERF_POSITION);
+
+	/* Reduce the done flags of all strips */
+	int d = 1;
+	for(s = 0; s < strips; ++s)
+		d &= done[s];
+
+	return d;
+}
+
+/*****************************/
+static int relax_colored(
+	unsigned int size,
+	float        scale,
+	float        weight,
+	Vertices*    data,
+	Constraints* cons)
+{
+	/* One strip per thread, the colours keep threads out of each other's way */
+	/* Vertices of a colour never touch each other's neighbours, so the order is irrelevant */
+	/* Which is why any number of strips gives the same result */
+	unsigned int strips = pool_threads();
+	if(strips > size)
+		strips = size;
+
+	int done[strips];
+	RelaxSweep sweep = {
+		.size   = size,
+		.scale  = scale,
+		.weight = weight,
+		.data   = data,
+		.cons   = cons,
+		.inp    = data->h,
+		.out    = data->h,
+		.strips = strips,
+		.phase  = 0,
+		.color  = 0,
+		.done   = done,
+		.moved  = NULL,
+		.prev   = NULL,
+		.omega  = 1
+	};
+
+	unsigned int s;
+	for(s = 0; s < strips; ++s)
+		done[s] = 1;
+
+	/* Relax one colour at a time, so each colour sees the fresh heights of the others */
+	PERF_BEGIN(PERF_SWEEP);
+	for(sweep.color = 0; sweep.color < COLORS; ++sweep.color)
+		pool_run(strips, relax_color_strip, &sweep);
+	PERF_END(PERF_SWEEP);
+
+	PERF_BEGIN(PERF_POSITION);
+	pool_run(strips, relax_position_strip, &sweep);
+	PERF_END(PERF_POSITION);
+
+	/* Reduce the done flags of all strips */
+	int d = 1;
+	for(s = 0; s < strips; ++s)
+		d &= done[s];
+
+	return d;
+}
+
+/*****************************/
+static int compare_indices(const void* a, const void* b)
+{
+	unsigned int ia = *(const unsigned int*)a;
+	unsigned int ib = *(const unsigned int*)b;
+
+	return (ia > ib) - (ia < ib);
+}
+
+/*****************************/
+static void queue_neighbourhood(
+	unsigned int size,
+	unsigned int ix,
+	ActiveSet*   set,
+	Vertices*    data)
+{
+	/* When ix moves its neighbourhood, it moves every neighbourhood that overlaps */
+	/* So queue all vertices up to 2 vertices away, their constraints need checking */
+	/* Without roughness each neighbourhood is a plus shape, so only a diamond overlaps */
+	int c0 = ix / size;
+	int r0 = ix % size;
+	int c, r;
+	for(c = c0 - 2; c <= c0 + 2; ++c)
+		for(r = r0 - 2; r <= r0 + 2; ++r)
+		{
+			if(c < 0 || c >= (int)size || r < 0 || r >= (int)size)
+				continue;
+			if(!USE_ROUGHNESS && abs(c - c0) + abs(r - r0) > 2)
+				continue;
+
+			/* Unconstrained vertices have nothing to check */
+			unsigned int j = c * size + r;
+			if(!data->flags[j] || set->marks[j])
+				continue;
+
+			set->marks[j] = 1;
+			set->next[set->queued++] = j;
+		}
+}
+
+/*****************************/
+static ActiveSet* create_active_set(unsigned int size, Vertices* data)
+{
+	/* Allocate the struct and all its arrays in one go */
+	size_t n = size * size;
+	ActiveSet* set = malloc(
+		sizeof(ActiveSet) + sizeof(unsigned int) * n * 2 + n);
+
+	if(set == NULL)
+		return NULL;
+
+	set->list = (unsigned int*)(set + 1);
+	set->next = set->list + n;
+	set->marks = (unsigned char*)(set->next + n);
+	set->count = 0;
+	set->queued = 0;
+
+	/* At first, every constrained vertex needs checking */
+	unsigned int ix;
+	for(ix = 0; ix < n; ++ix)
+	{
+		set->marks[ix] = (data->flags[ix] != 0);
+		if(set->marks[ix])
+			set->next[set->queued++] = ix;
+	}
+
+	return set;
+}
+
+/*****************************/
+static int relax_active(
+	unsigned int size,
+	float        scale,
+	float        weight,
+	ActiveSet*   set,
+	Vertices*    data)
+{
+	int done = 1;
+
+	/* Make the queued vertices the current worklist */
+	/* Sorted, so we still sweep in memory order like the sequential mode */
+	unsigned int* t = set->list;
+	set->list = set->next;
+	set->next = t;
+	set->count = set->queued;
+	set->queued = 0;
+
+	qsort(set->list, set->count, sizeof(unsigned int), compare_indices);
+
+	unsigned int i;
+	for(i = 0; i < set->count; ++i)
+		set->marks[set->list[i]] = 0;
+
+	/* Relax the worklist, everything that moves queues its surroundings */
+	PERF_BEGIN(PERF_SWEEP);
+	for(i = 0; i < set->count; ++i)
+		if(!relax_vertex(size, set->list[i], scale, weight, data, data->h, data->h))
+		{
+			queue_neighbourhood(size, set->list[i], set, data);
+			done = 0;
+		}
+	PERF_END(PERF_SWEEP);
 
+	/* Only vertices that were just relaxed or moved can violate a position constraint */
+	/* Both are in either of the lists, so that's all we need to check */
+	PERF_BEGIN(PERF_POSITION);
+	unsigned int queued = set->queued;
+	unsigned int l;
+	for(l = 0; l < 2; ++l)
+	{
+		unsigned int* list = l ? set->next : set->list;
+		unsigned int count = l ? queued : set->count;
+
+		for(i = 0; i < count; ++i)
+		{
+			unsigned int ix = list[i];
+			if(!(data->flags[ix] & POSITION) || data->h[ix] == data->c[2][ix])
+				continue;
+
+			data->h[ix] = data->c[2][ix];
+			queue_neighbourhood(size, ix, set, data);
+			done = 0;
+		}
+	}
+	PERF_END(PERF_POSITION);
+
+	return done;
+}
+
+/*****************************/
+static void sync_range(unsigned int begin, unsigned int end, void* data)
+{
+	SyncColumns* sync = data;
+	unsigned int size = sync->size;
+
+	/* A column that moved writes to itself and the columns next to it */
+	/* Those are the only columns where dst and src can differ */
+	unsigned int c;
+	for(c = begin; c < end; ++c)
+		if(sync->moved[c] ||
+			(c > 0 && sync->moved[c-1]) ||
+			(c < size-1 && sync->moved[c+1]))
+		{
+			memcpy(sync->dst + c * size, sync->src + c * size, sizeof(float) * size);
+		}
+}
+
+/*****************************/
+static void sync_columns(
+	unsigned int   size,
+	float*         dst,
+	float*         src,
+	unsigned char* moved)
+{
+	/* Columns are independent, so spread them evenly over all threads */
+	SyncColumns sync = {
+		.size  = size,
+		.dst   = dst,
+		.src   = src,
+		.moved = moved
+	};
+
+	pool_for(size, 0, sync_range, &sync);
+}
+
+/*****************************/
+static void swap_heights(size_t n, float* a, float* b)
+{
+	/* Only happens once a call, so no need to spread it over threads */
+	size_t ix;
+	for(ix = 0; ix < n; ++ix)
+	{
+		float t = a[ix];
+		a[ix] = b[ix];
+		b[ix] = t;
+	}
+}
+
+/*****************************/
+static float next_chebyshev_omega(unsigned int k, float rho, float omega)
+{
+	/* omega(1) = 1, omega(2) = 2 / (2 - rho^2), omega(k+1) = 4 / (4 - rho^2 omega(k)) */
+	/* Where omega is the previous factor */
+	return
+		(k <= 1) ? 1 :
+		(k == 2) ? 2 / (2 - rho*rho) :
+		4 / (4 - rho*rho*omega);
+}
+
+/*****************************/
+static unsigned int relax_slope_1d(
+	unsigned int size,
+	float        scale,
+	float        maxSlope,
+	float*       mid)
+{
 	/* Count the number of iterations */
 	unsigned int i = 0;
 	while(i < MAX_ITERATIONS)
@@ -266,8 +1077,7 @@ int mod_relax_slope_1d(unsigned int size, Vertex* data, ModData* mod)
 		unsigned int r;
 		for(r = 0; r < size-1; ++r)
 		{
-			float s = (mid[r+1].h - mid[r].h) / scale;
-			float maxSlope = 0.0025f;
+			float s = (mid[r+1] - mid[r]) / scale;
 
 			/* Add the convergence threshold to the comparison */
 			/* If we do not, it may never exit due to floating point errors */
@@ -286,7 +1096,159 @@ int mod_relax_slope_1d(unsigned int size, Vertex* data, ModData* mod)
 		if(done) break;
 	}
 
-	output("Slope relaxation took %u iterations.", i);
+	return i;
+}
+
+/*****************************/
+static int solve_slope_1d(unsigned int size, double d, float* mid)
+{
+	/* Finds the closest heights (least squares) with |mid[r+1] - mid[r]| <= d for all r */
+	/* Shifting all heights keeps them satisfied, so the closest ones move no material in total */
+	/* Which makes it a valid way of moving material, just like move_slope */
+	/* Dynamic programming: f_r(v) is the least cost of the first r+1 heights with mid[r] = v */
+	/* f_r(v) = (v - mid[r])^2 + the minimum of f_{r-1} within d of v, each f_r is convex */
+	/* Its derivative is piecewise linear, we keep the knots where its slope changes */
+	/* Taking the minimum within d moves the knots left of the minimum left by d, the others right */
+	/* So they stay in order, and live in a gap buffer with the gap at the current minimum */
+	/* Each vertex adds two knots, finding the next minimum only crosses the knots in between */
+	/* Then backwards, each height is the minimum of f_r, but clamped to within d of the next */
+	unsigned int cap = size * 2;
+	double* pos = malloc(sizeof(double) * (cap * 2 + size));
+	if(pos == NULL)
+		return 0;
+
+	double* jump = pos + cap; /* Change of the slope of the derivative at each knot */
+	double* mins = jump + cap;
+
+	/* Left knots are in [0,nl), right knots in [cap-nr,cap) */
+	/* Positions are stored relative to how far their side moved so far */
+	unsigned int nl = 0, nr = 0;
+	double sl = 0, sr = 0;
+
+	/* The derivative is a*v + b in the gap */
+	double a = 2;
+	double b = -2.0 * mid[0];
+	mins[0] = mid[0];
+
+	unsigned int r;
+	for(r = 1; r < size; ++r)
+	{
+		/* The minimum within d of v, flat within d of the previous minimum */
+		double z = mins[r-1];
+		sl += d;
+		sr += d;
+
+		pos[nl] = (z - d) + sl;
+		jump[nl++] = -a;
+		pos[cap - ++nr] = (z + d) - sr;
+		jump[cap - nr] = a;
+
+		/* Add the cost of this vertex, and move the gap to where the derivative is zero */
+		/* The slopes are all even integers, so a is exact and always >= 2 */
+		a = 2;
+		b = -2.0 * mid[r];
+
+		for(;;)
+		{
+			z = -b / a;
+
+			if(nl > 0 && z < pos[nl-1] - sl)
+			{
+				double p = pos[--nl] - sl;
+				double c = jump[nl];
+				a -= c;
+				b += c * p;
+				pos[cap - ++nr] = p - sr;
+				jump[cap - nr] = c;
+			}
+			else if(nr > 0 && z > pos[cap-nr] + sr)
+			{
+				double p = pos[cap-nr] + sr;
+				double c = jump[cap - nr--];
+				a += c;
+				b -= c * p;
+				pos[nl] = p + sl;
+				jump[nl++] = c;
+			}
+			else
+				break;
+		}
+
+		mins[r] = z;
+	}
+
+	/* And backwards */
+	double x = mins[size-1];
+	mid[size-1] = x;
+
+	for(r = size-1; r-- > 0;)
+	{
+		x = (mins[r] < x - d) ? x - d : (mins[r] > x + d) ? x + d : mins[r];
+		mid[r] = x;
+	}
+
+	free(pos);
+
+	return 1;
+}
+
+/*****************************/
+int mod_relax_slope_1d(unsigned int size, Vertices* data, ModData* mod)
+{
+	float scale = GET_SCALE(size);
+	float maxSlope = 0.0025f;
+
+	/* Only modify the center column */
+	float* mid = data->h + ((size >> 1) * size);
+
+	if(mod->mode != DIRECT)
+	{
+		unsigned int i = relax_slope_1d(size, scale, maxSlope, mid);
+		output("Slope relaxation took %u iterations.", i);
+
+		/* We don't need to iterate this modifier */
+		mod->done = 1;
+		return 1;
+	}
+
+	/* Keep the input around to compare against iterative relaxation */
+	float* iter = SLOPE_1D_COMPARE ? malloc(sizeof(float) * size) : NULL;
+	if(iter != NULL)
+		memcpy(iter, mid, sizeof(float) * size);
+	else if(SLOPE_1D_COMPARE)
+		throw_error("Failed to allocate memory to compare against slope relaxation.");
+
+	double t = get_time();
+	if(!solve_slope_1d(size, maxSlope * scale, mid))
+	{
+		throw_error("Failed to allocate memory for the direct slope solver.");
+		free(iter);
+		return 0;
+	}
+
+	output("Direct slope solve took %f ms.", (get_time() - t) * 1e3);
+
+	if(iter != NULL)
+	{
+		t = get_time();
+		unsigned int i = relax_slope_1d(size, scale, maxSlope, iter);
+		t = get_time() - t;
+
+		/* Both move material, just not in the same way */
+		float diff = 0;
+		double sum = 0;
+		unsigned int r;
+		for(r = 0; r < size; ++r)
+		{
+			diff = fmaxf(diff, fabsf(mid[r] - iter[r]));
+			sum += fabsf(mid[r] - iter[r]);
+		}
+
+		output("Slope relaxation took %u iterations, %f ms.", i, t * 1e3);
+		output("Direct solve differs by at most %f, %f on average.", diff, sum / size);
+
+		free(iter);
+	}
 
 	/* We don't need to iterate this modifier */
 	mod->done = 1;
@@ -294,26 +1256,131 @@ int mod_relax_slope_1d(unsigned int size, Vertex* data, ModData* mod)
 }
 
 /*****************************/
-int mod_relax(unsigned int size, Vertex* data, ModData* mod)
+void finish_relax(ModData* mod, int done)
+{
+	output("Relaxation took %u iterations.", mod->iterations);
+
+	free(mod->buffer);
+	free(mod->work);
+	mod->buffer = NULL;
+	mod->work = NULL;
+	mod->done = 1;
+	mod->converged = done;
+
+	/* Open a file to append this terrain's data to it */
+	/* Obviously only do this when an output file was given */
+	if(mod->out == NULL)
+		return;
+
+	TRACE_BEGIN(write);
+	FILE* f = fopen(mod->out, "a");
+	if(f == NULL)
+	{
+		throw_error("Could not open file: %s", mod->out);
+		return;
+	}
+
+	/* Write number of iterations to file */
+	/* When max iterations was reached, write nothing */
+	if(done)
+		fprintf(f, "%u\n", mod->iterations);
+	else
+		fputs("-\n", f);
+
+	fclose(f);
+	TRACE_END(write, "write_iterations");
+
+	output("Iteration count has been written to file: %s", mod->out);
+}
+
+/*****************************/
+int mod_relax(unsigned int size, Vertices* data, ModData* mod)
 {
 	float scale = GET_SCALE(size);
 
-	/* Allocate a buffer for input if it wasn't there yet */
+	/* Allocate a second buffer of heights if it wasn't there yet */
 	/* We just leave it empty if no parallelism allowed */
-	size_t buffSize = sizeof(Vertex) * size * size;
+	/* If Chebyshev accelerated, followed by the heights of the previous iteration */
+	/* Then the state of Chebyshev acceleration, unused if not accelerated */
+	/* Followed by a flag for each column that moved */
+	size_t n = size * size;
+	size_t planes = (mod->accel.type == CHEBYSHEV) ? 2 : 1;
+
 	if(mod->mode == PARALLEL && mod->buffer == NULL)
 	{
-		mod->buffer = malloc(buffSize);
+		mod->buffer = malloc(
+			sizeof(float) * n * planes + sizeof(Chebyshev) + sizeof(unsigned char) * size);
 		if(mod->buffer == NULL)
 		{
 			throw_error("Failed to allocate memory for a relaxation buffer.");
 			return 0;
 		}
+
+		/* Between calls all buffers hold the same heights */
+		size_t p;
+		for(p = 0; p < planes; ++p)
+			memcpy(mod->buffer + n * p, data->h, sizeof(float) * n);
+
+		/* Start over at the first iteration */
+		Chebyshev* cheb = (Chebyshev*)(mod->buffer + n * planes);
+		cheb->start = 0;
+		cheb->base = 0;
+		cheb->moving = 0;
+		cheb->change = 0;
+		cheb->rho = (mod->accel.param > 0) ? mod->accel.param : 0;
+		cheb->omega = 1;
+		cheb->swapped = 0;
+
+		memset(cheb + 1, 0, sizeof(unsigned char) * size);
 	}
 
-	/* Now define the input buffer */
-	/* For parallelism we use the buffer, otherwise just data */
-	Vertex* inp = mod->mode == PARALLEL ? mod->buffer : data;
+	/* The envelope flattens slope regions before anything else */
+	/* What's left is mostly near their borders, which the active set is good at */
+	int active = (mod->mode == ACTIVE || mod->mode == ENVELOPE);
+	if(mod->mode == ENVELOPE && mod->work == NULL && !envelope_slopes(size, data))
+		return 0;
+
+	/* Compile the constraints if sweeping over all of them */
+	/* The flags don't change anymore once we are relaxing */
+	if(!active && mod->work == NULL)
+	{
+		mod->work = create_constraints(size, data);
+		if(mod->work == NULL)
+			return 0;
+	}
+
+	/* Create a worklist if only relaxing the active set */
+	if(active && mod->work == NULL)
+	{
+		mod->work = create_active_set(size, data);
+		if(mod->work == NULL)
+		{
+			throw_error("Failed to allocate memory for a relaxation worklist.");
+			return 0;
+		}
+	}
+
+	/* Now define the input and output buffers */
+	/* For parallelism they are swapped each iteration, otherwise it's just the heights */
+	float* inp = data->h;
+	float* out = data->h;
+	float* prev = NULL;
+	Chebyshev* cheb = NULL;
+	unsigned char* moved = NULL;
+
+	if(mod->mode == PARALLEL)
+	{
+		out = mod->buffer;
+		prev = (planes > 1) ? mod->buffer + n : NULL;
+		cheb = (Chebyshev*)(mod->buffer + n * planes);
+		moved = (unsigned char*)(cheb + 1);
+
+		if(prev && cheb->swapped)
+		{
+			inp = prev;
+			prev = data->h;
+		}
+	}
 
 	/* And also define a weight */
 	/* Each point is touched 4 times by each slope constraint in all 4 cardinal directions */
@@ -322,80 +1389,122 @@ int mod_relax(unsigned int size, Vertex* data, ModData* mod)
 	/* Do note: each point needs to have the same weight to preserve the EMD property */
 	float weight = mod->mode == PARALLEL ? 1/25.0f : 1;
 
+	/* Over-relaxation scales all moves, which preserves the EMD just the same */
+	if(mod->accel.type == OVER_RELAX)
+		weight *= (mod->accel.param > 0) ? mod->accel.param : SOR_OMEGA;
+
 	/* Count the number of iterations */
+	/* Do as many as were asked for, or the default step size */
+	unsigned int steps = (mod->steps > 0) ? mod->steps : STEP_SIZE;
+	unsigned int start = mod->iterations;
 	unsigned int i = 0;
-	while(i < STEP_SIZE)
+	int done = 0;
+
+	TRACE_BEGIN(iterations);
+	while(i < steps)
 	{
-		int done = 1;
+		done = 1;
 		++i;
 		++mod->iterations;
 
-		/* Prepare input buffer if parallel */
-		if(mod->mode == PARALLEL)
-			memcpy(mod->buffer, data, buffSize);
-
-		/* Loop over all vertices and apply the relevant constraints */
-		unsigned int ix;
-		for(ix = 0; ix < size*size; ++ix)
+		/* Prepare output buffer if parallel, it has to start off equal to the input */
+		/* It already is, apart from the columns the last iteration moved */
+		/* Then spread the sweep over all threads and swap the buffers */
+		if(mod->mode == PARALLEL && prev)
 		{
-			if(inp[ix].flags & SLOPE)
-				done &= relax_slope(size, ix, scale, weight, inp, data);
-			if(inp[ix].flags & DIR_SLOPE)
-				done &= relax_dir_slope(size, ix, scale, weight, inp, data);
-			if(inp[ix].flags & ROUGHNESS)
-				done &= relax_roughness(size, ix, scale, weight, inp, data);
-		}
+			/* If accelerated the sweep gets its own output to extrapolate from */
+			/* That moves everything, so there's no point in tracking columns */
+			/* Whenever it starts over, the first CHEB_WARMUP iterations are plain sweeps */
+			/* Those estimate the spectral radius of the weighted sweep, unless one was given */
+			/* As its moves shrink by about that much each time, capped so omega stays below 2 */
+			unsigned int k = mod->iterations - cheb->start;
+			unsigned int warmup = (mod->accel.param > 0) ? 0 : CHEB_WARMUP;
+			float change = cheb->change;
 
-		/* Loop over all vertices again for the position constraint */
-		/* It is important this is handled as last and separately */
-		/* This is because it overrides the height of a vertex completely */
-		/* This is the part where we are allowed to create/destroy material */
-		for(ix = 0; ix < size*size; ++ix)
-			if(inp[ix].flags & POSITION)
-			{
-				done &= (data[ix].h == inp[ix].c[2]);
-				data[ix].h = inp[ix].c[2];
-			}
+			cheb->omega = (k <= warmup) ? 1 :
+				next_chebyshev_omega(k - warmup, cheb->rho, cheb->omega);
+			done = relax_parallel(
+				size, scale, weight, data, mod->work, inp, out, moved, prev, cheb);
 
-		/* Exit if no changes were made */
-		/* Or when the maximum number of iterations ended */
-		if(done || mod->iterations == MAX_ITERATIONS)
-		{
-			output("Relaxation took %u iterations.", mod->iterations);
+			if(k > 1 && k <= warmup && change > 0)
+				cheb->rho = fminf(sqrtf(cheb->change / change), CHEB_RHO_MAX);
 
-			free(mod->buffer);
-			mod->buffer = NULL;
-			mod->done = 1;
+			/* Start over once the sweep moves a rather different number of vertices */
+			/* Otherwise the extrapolation carries on past constraints that just got satisfied */
+			if(k == 1)
+				cheb->base = cheb->moving;
+			else if(fabs((double)cheb->moving - cheb->base) > CHEB_RESTART * cheb->base)
+				cheb->start = mod->iterations;
 
-			/* Open a file to append this terrain's data to it */
-			/* Obviously only do this when an output file was given */
-			if(mod->out == NULL)
-				break;
-
-			FILE* f = fopen(mod->out, "a");
-			if(f == NULL)
-			{
-				throw_error("Could not open file: %s", mod->out);
-				break;
-			}
+			/* The new iteration was written over the previous one, swap them */
+			float* t = inp;
+			inp = prev;
+			prev = t;
+			cheb->swapped = !cheb->swapped;
+		}
+		else if(mod->mode == PARALLEL)
+		{
+			sync_columns(size, out, inp, moved);
+			done = relax_parallel(
+				size, scale, weight, data, mod->work, inp, out, moved, NULL, NULL);
 
-			/* Write number of iterations to file */
-			/* When max iterations was reached, write nothing */
-			if(done)
-				fprintf(f, "%u\n", mod->iterations);
-			else
-				fputs("-\n", f);
+			float* t = inp;
+			inp = out;
+			out = t;
+		}
+		else if(mod->mode == COLORED)
+		{
+			/* Gauss-Seidel, but ordered by colour so it can be spread over threads */
+			done = relax_colored(size, scale, weight, data, mod->work);
+		}
+		else if(active)
+		{
+			/* Only relax what could have changed since the last iteration */
+			done = relax_active(size, scale, weight, mod->work, data);
+		}
+		else
+		{
+			/* Loop over all vertices and apply the relevant constraints */
+			PERF_BEGIN(PERF_SWEEP);
+			done &= relax_columns(
+				size, 0, size, scale, weight, data, mod->work, inp, data->h);
+			PERF_END(PERF_SWEEP);
 
-			fclose(f);
-			output("Iteration count has been written to file: %s", mod->out);
+			/* Loop over all vertices again for the position constraint */
+			/* It is important this is handled as last and separately */
+			/* This is because it overrides the height of a vertex completely */
+			/* This is the part where we are allowed to create/destroy material */
+			PERF_BEGIN(PERF_POSITION);
+			done &= relax_position(size, 0, size, mod->work, data->h);
+			PERF_END(PERF_POSITION);
+		}
 
+		/* Exit if no changes were made */
+		/* Or when the maximum number of iterations ended */
+		if(done || mod->iterations == MAX_ITERATIONS)
 			break;
-		}
 	}
+	TRACE_END(iterations, "relax_iterations");
+
+	/* Make sure both buffers are equal again, so the heights are up to date */
+	/* If accelerated, swap the heights back if they hold the previous iteration */
+	if(mod->mode == PARALLEL && !prev)
+	{
+		sync_columns(size, out, inp, moved);
+		memset(moved, 0, size);
+	}
+	else if(mod->mode == PARALLEL && cheb->swapped)
+	{
+		swap_heights(n, inp, prev);
+		cheb->swapped = 0;
+	}
+
+	if(done || mod->iterations == MAX_ITERATIONS)
+		finish_relax(mod, done);
 
 	/* If we haven't finished all iterations yet, output where we are */
-	/* Only print if we're at a multiple of ITER_PRINT though */
-	if(!mod->done && (mod->iterations % ITER_PRINT == 0))
+	/* Only print if we passed a multiple of ITER_PRINT though */
+	if(!mod->done && (start / ITER_PRINT != mod->iterations / ITER_PRINT))
 		output("%u iterations...", mod->iterations);
 
 	return 1;
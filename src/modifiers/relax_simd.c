@@ -0,0 +1,175 @@
+#include "constants.h"
+#include "modifiers.h"
+#include "patch.h"
+#include <string.h>
+
+/* Only x86 kernels for now, picked at runtime */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define SIMD_X86 1
+	#include <immintrin.h>
+#else
+	#define SIMD_X86 0
+#endif
+
+
+#if SIMD_X86
+
+/* Vectors of 4 and 8 floats, and the masks that comparing them gives */
+typedef float v4f __attribute__((vector_size(16)));
+typedef int   v4i __attribute__((vector_size(16)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef int   v8i __attribute__((vector_size(32)));
+
+/* Picks a where the mask is set and b elsewhere */
+#define SELECT(VF, VI, m, a, b) ((VF)(((VI)(a) & (m)) | ((VI)(b) & ~(m))))
+
+/* Absolute value, by clearing the sign bit */
+#define ABS(VF, VI, a) ((VF)((VI)(a) & 0x7fffffff))
+
+/* Loads and stores, the rows of a column are not necessarily aligned */
+#define LOAD(v, p) memcpy(&(v), (p), sizeof(v))
+#define STORE(p, v) memcpy((p), &(v), sizeof(v))
+
+
+/* The kernel itself, the same for each vector width W */
+/* Each lane is a row, so it is the same as relax_slope and relax_dir_slope for W rows at once */
+/* The sweep is Jacobi, so each correction only has to be added to out */
+/* Up to rounding that is, as the corrections of W rows are added at once, per direction */
+/* Also unlike relax_slope, |g| is not computed with hypotf, nor moves in double precision */
+/* There is no FMA, avx2 does not imply it and -std=c99 turns contraction off */
+/* But W itself changes the order, so AVX2 and SSE2 differ as well */
+/* Lanes that satisfy their constraints get a factor of 1, i.e. they don't move */
+#define SLOPE_KERNEL(VF, VI, W, SQRT) \
+{ \
+	const int ox[4] = { (int)size, -1, -(int)size, 1 }; \
+	const int oy[4] = { 1, (int)size, -1, -(int)size }; \
+	const float hw = .5f * weight; \
+	\
+	VF one = { 0 }; \
+	VI moved = { 0 }; \
+	one += 1.0f; \
+	\
+	unsigned int r; \
+	for(r = 1; r + W < size; r += W) \
+	{ \
+		unsigned int ix = c * size + r; \
+		unsigned int l, d; \
+		\
+		/* Skip the vector if it is all unconstrained (or roughness) */ \
+		VI sm, dm; \
+		int any = 0; \
+		for(l = 0; l < W; ++l) \
+		{ \
+			sm[l] = -((data->flags[ix+l] & SLOPE) != 0); \
+			dm[l] = -((data->flags[ix+l] & DIR_SLOPE) != 0); \
+			any |= sm[l] | dm[l]; \
+		} \
+		if(!any) continue; \
+		\
+		VF h, c0, c1, hx, hy, o; \
+		LOAD(h, inp + ix); \
+		LOAD(c0, data->c[0] + ix); \
+		LOAD(c1, data->c[1] + ix); \
+		\
+		/* The directional constraint is the same for all directions */ \
+		VF ms = SQRT(c0 * c0 + c1 * c1); \
+		VF dx = c0 / ms; \
+		VF dy = c1 / ms; \
+		VF acc = { 0 }; \
+		\
+		for(d = 0; d < 4; ++d) \
+		{ \
+			LOAD(hx, inp + ix + ox[d]); \
+			LOAD(hy, inp + ix + oy[d]); \
+			VF sx = (hx - h) / scale; \
+			VF sy = (hy - h) / scale; \
+			\
+			/* Scale the gradient by MaxSlope/|g| */ \
+			VF g = SQRT(sx * sx + sy * sy); \
+			VI vs = sm & (g > c0 + S_THRESHOLD); \
+			VF fs = SELECT(VF, VI, vs, c0 / g, one); \
+			\
+			/* Scale the directional derivative by MaxSlope/d */ \
+			VF dd = ABS(VF, VI, sx * dx + sy * dy); \
+			VI vd = dm & (dd > ms + S_THRESHOLD); \
+			VF fd = SELECT(VF, VI, vd, ms / dd, one); \
+			\
+			/* Signed version of move_slope, positive moves the vertex itself up */ \
+			VF tx = (sx - sx * fs) * scale * hw + (sx - sx * fd) * scale * hw; \
+			VF ty = (sy - sy * fs) * scale * hw + (sy - sy * fd) * scale * hw; \
+			\
+			acc += tx + ty; \
+			LOAD(o, out + ix + ox[d]); o -= tx; STORE(out + ix + ox[d], o); \
+			LOAD(o, out + ix + oy[d]); o -= ty; STORE(out + ix + oy[d], o); \
+			moved |= vs | vd; \
+		} \
+		\
+		LOAD(o, out + ix); o += acc; STORE(out + ix, o); \
+	} \
+	\
+	unsigned int l; \
+	int done = 1; \
+	for(l = 0; l < W; ++l) \
+		done &= !moved[l]; \
+	\
+	*rows = r - 1; \
+	return done; \
+}
+
+/*****************************/
+__attribute__((target("avx2")))
+static int relax_column_avx2(
+	unsigned int  size,
+	unsigned int  c,
+	float         scale,
+	float         weight,
+	Vertices*     data,
+	float*        inp,
+	float*        out,
+	unsigned int* rows)
+{
+	#define SQRT_AVX2(x) ((v8f)_mm256_sqrt_ps((__m256)(x)))
+	SLOPE_KERNEL(v8f, v8i, 8, SQRT_AVX2)
+}
+
+/*****************************/
+__attribute__((target("sse2")))
+static int relax_column_sse2(
+	unsigned int  size,
+	unsigned int  c,
+	float         scale,
+	float         weight,
+	Vertices*     data,
+	float*        inp,
+	float*        out,
+	unsigned int* rows)
+{
+	#define SQRT_SSE2(x) ((v4f)_mm_sqrt_ps((__m128)(x)))
+	SLOPE_KERNEL(v4f, v4i, 4, SQRT_SSE2)
+}
+
+#endif
+
+/*****************************/
+int relax_column_simd(
+	unsigned int  size,
+	unsigned int  c,
+	float         scale,
+	float         weight,
+	Vertices*     data,
+	float*        inp,
+	float*        out,
+	unsigned int* rows)
+{
+	/* Pick the widest kernel the CPU supports */
+#if SIMD_X86
+	if(__builtin_cpu_supports("avx2"))
+		return relax_column_avx2(size, c, scale, weight, data, inp, out, rows);
+	if(__builtin_cpu_supports("sse2"))
+		return relax_column_sse2(size, c, scale, weight, data, inp, out, rows);
+#endif
+
+	/* Nothing supported, leave it all to the scalar path */
+	*rows = 0;
+	return 1;
+}
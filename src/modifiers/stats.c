@@ -3,7 +3,10 @@
 #include "modifiers.h"
 #include "output.h"
 #include "patch.h"
+#include "perf.h"
+#include "trace.h"
 #include <math.h>
+#include <string.h>
 
 /* Check if two indices are on the same column */
 #define SAME_COLUMN(i,j,size) ((i/size) == (j/size))
@@ -11,7 +14,7 @@
 /*****************************/
 static float total_supplies(
 	unsigned int size,
-	Vertex*      data)
+	Vertices*    data)
 {
 	/* Total supplies */
 	/* Thinking in Earth Mover's Distance terms, */
@@ -20,7 +23,7 @@ static float total_supplies(
 	float t = 0;
 	unsigned int i;
 	for(i = 0; i < size * size; ++i)
-		t += data[i].h;
+		t += data->h[i];
 
 	return t;
 }
@@ -28,7 +31,7 @@ static float total_supplies(
 /*****************************/
 static float max_slope_1d(
 	unsigned int size,
-	Vertex*      data)
+	Vertices*    data)
 {
 	float scale = GET_SCALE(size);
 
@@ -40,22 +43,22 @@ static float max_slope_1d(
 	for(c = 0; c < size-1; ++c)
 		for(r = 0; r < size; ++r)
 		{
-			if(!(data[c * size + r].flags & SLOPE))
+			if(!(data->flags[c * size + r] & SLOPE))
 				continue;
 
 			/* Get slope in x direction */
-			float s = (data[(c+1) * size + r].h - data[c * size + r].h) / scale;
+			float s = (data->h[(c+1) * size + r] - data->h[c * size + r]) / scale;
 			m = s > 0 ? (s > m ? s : m) : (-s > m ? -s : m);
 		}
 
 	for(c = 0; c < size; ++c)
 		for(r = 0; r < size-1; ++r)
 		{
-			if(!(data[c * size + r].flags & SLOPE))
+			if(!(data->flags[c * size + r] & SLOPE))
 				continue;
 
 			/* Get slope in y direction */
-			float s = (data[c * size + r+1].h - data[c * size + r].h) / scale;
+			float s = (data->h[c * size + r+1] - data->h[c * size + r]) / scale;
 			m = s > 0 ? (s > m ? s : m) : (-s > m ? -s : m);
 		}
 
@@ -64,29 +67,23 @@ static float max_slope_1d(
 
 /*****************************/
 static float max_slope(
-	unsigned int  size,
-	Vertex*       data,
-	unsigned int* count,
-	unsigned int* satisfied,
-	unsigned int* unsatisfied,
-	float*        avgDistance)
+	unsigned int     size,
+	Vertices*        data,
+	ConstraintStats* stats)
 {
 	float scale = GET_SCALE(size);
 
-	*count = 0;
-	*satisfied = 0;
-	*unsatisfied = 0;
-	*avgDistance = 0;
+	memset(stats, 0, sizeof(ConstraintStats));
 
 	/* Maximum 2D slope, i.e. the magnitude of the gradient vector */
 	float m = 0;
 	unsigned int ix;
 	for(ix = 0; ix < size*size; ++ix)
 	{
-		if(!(data[ix].flags & SLOPE))
+		if(!(data->flags[ix] & SLOPE))
 			continue;
 
-		++(*count);
+		++stats->count;
 
 		/* Loop over all 4 cardinal directions */
 		unsigned int sat = 1;
@@ -98,51 +95,45 @@ static float max_slope(
 				continue;
 
 			/* Get the gradient */
-			float sx = (data[ixx].h - data[ix].h) / scale;
-			float sy = (data[ixy].h - data[ix].h) / scale;
+			float sx = (data->h[ixx] - data->h[ix]) / scale;
+			float sy = (data->h[ixy] - data->h[ix]) / scale;
 			float g = sqrtf(sx * sx + sy * sy);
 
-			*avgDistance += fmaxf(0.0f, g - data[ix].c[0]);
-			sat &= (g <= data[ix].c[0] + S_THRESHOLD);
+			stats->distance += fmaxf(0.0f, g - data->c[0][ix]);
+			sat &= (g <= data->c[0][ix] + S_THRESHOLD);
 			m = g > m ? g : m;
 		}
 
 		if(sat)
-			++(*satisfied);
+			++stats->satisfied;
 		else
-			++(*unsatisfied);
+			++stats->unsatisfied;
 	}
 
-	if(*count)
-		*avgDistance /= (*count) * 4;
+	if(stats->count)
+		stats->distance /= stats->count * 4;
 
 	return m;
 }
 
 /*****************************/
 static void count_dir_slope(
-	unsigned int  size,
-	Vertex*       data,
-	unsigned int* count,
-	unsigned int* satisfied,
-	unsigned int* unsatisfied,
-	float*        avgDistance)
+	unsigned int     size,
+	Vertices*        data,
+	ConstraintStats* stats)
 {
 	float scale = GET_SCALE(size);
 
-	*count = 0;
-	*satisfied = 0;
-	*unsatisfied = 0;
-	*avgDistance = 0;
+	memset(stats, 0, sizeof(ConstraintStats));
 
 	/* Just count satisfied and unsatisfied, there is no global "maximum" or anything */
 	unsigned int ix;
 	for(ix = 0; ix < size*size; ++ix)
 	{
-		if(!(data[ix].flags & DIR_SLOPE))
+		if(!(data->flags[ix] & DIR_SLOPE))
 			continue;
 
-		++(*count);
+		++stats->count;
 
 		/* Loop over all 4 cardinal directions */
 		unsigned int sat = 1;
@@ -154,147 +145,140 @@ static void count_dir_slope(
 				continue;
 
 			/* This scales directional derivative d by MaxSlope/d */
-			float maxSlope = hypotf(data[ix].c[0], data[ix].c[1]);
-			float dx = data[ix].c[0] / maxSlope;
-			float dy = data[ix].c[1] / maxSlope;
-			float sx = (data[ixx].h - data[ix].h) / scale;
-			float sy = (data[ixy].h - data[ix].h) / scale;
+			float maxSlope = hypotf(data->c[0][ix], data->c[1][ix]);
+			float dx = data->c[0][ix] / maxSlope;
+			float dy = data->c[1][ix] / maxSlope;
+			float sx = (data->h[ixx] - data->h[ix]) / scale;
+			float sy = (data->h[ixy] - data->h[ix]) / scale;
 			float d = fabs(sx * dx + sy * dy);
 
-			*avgDistance += fmaxf(0.0f, d - maxSlope);
+			stats->distance += fmaxf(0.0f, d - maxSlope);
 			sat &= (d <= maxSlope + S_THRESHOLD);
 		}
 
 		if(sat)
-			++(*satisfied);
+			++stats->satisfied;
 		else
-			++(*unsatisfied);
+			++stats->unsatisfied;
 	}
 
-	if(*count)
-		*avgDistance /= (*count) * 4;
+	if(stats->count)
+		stats->distance /= stats->count * 4;
 }
 
 /*****************************/
 static void count_roughness(
-	unsigned int  size,
-	Vertex*       data,
-	unsigned int* count,
-	unsigned int* satisfied,
-	unsigned int* unsatisfied,
-	float*        avgDistance)
+	unsigned int     size,
+	Vertices*        data,
+	ConstraintStats* stats)
 {
 	float scale = GET_SCALE(size);
 
-	*count = 0;
-	*satisfied = 0;
-	*unsatisfied = 0;
-	*avgDistance = 0;
+	memset(stats, 0, sizeof(ConstraintStats));
 
 	/* Just count satisfied and unsatisfied, there is no global "maximum" or anything */
 	unsigned int ix;
 	for(ix = 0; ix < size*size; ++ix)
 	{
-		if(!(data[ix].flags & ROUGHNESS))
+		if(!(data->flags[ix] & ROUGHNESS))
 			continue;
 
-		float R = calc_roughness(size, data, ix, scale);
-		float dist = fabs(R - data[ix].c[0]);
+		float R = calc_roughness(size, data->h, ix, scale);
+		float dist = fabs(R - data->c[0][ix]);
 
-		++(*count);
-		*avgDistance += dist;
+		++stats->count;
+		stats->distance += dist;
 
 		if(dist <= R_THRESHOLD)
-			++(*satisfied);
+			++stats->satisfied;
 		else
-			++(*unsatisfied);
+			++stats->unsatisfied;
 	}
 
-	if(*count)
-		*avgDistance /= *count;
+	if(stats->count)
+		stats->distance /= stats->count;
 }
 
 /*****************************/
 static void count_position(
-	unsigned int  size,
-	Vertex*       data,
-	unsigned int* count,
-	unsigned int* satisfied,
-	unsigned int* unsatisfied,
-	float*        avgDistance)
+	unsigned int     size,
+	Vertices*        data,
+	ConstraintStats* stats)
 {
-	*count = 0;
-	*satisfied = 0;
-	*unsatisfied = 0;
-	*avgDistance = 0;
+	memset(stats, 0, sizeof(ConstraintStats));
 
 	/* Just count satisfied and unsatisfied, there is no global "maximum" or anything */
 	unsigned int ix;
 	for(ix = 0; ix < size*size; ++ix)
 	{
-		if(!(data[ix].flags & POSITION))
+		if(!(data->flags[ix] & POSITION))
 			continue;
 
-		++(*count);
-		*avgDistance += fabs(data[ix].h - data[ix].c[2]);
+		++stats->count;
+		stats->distance += fabs(data->h[ix] - data->c[2][ix]);
 
-		if(data[ix].h == data[ix].c[2])
-			++(*satisfied);
+		if(data->h[ix] == data->c[2][ix])
+			++stats->satisfied;
 		else
-			++(*unsatisfied);
+			++stats->unsatisfied;
 	}
 
-	if(*count)
-		*avgDistance /= *count;
+	if(stats->count)
+		stats->distance /= stats->count;
 }
 
 /*****************************/
-int mod_stats(unsigned int size, Vertex* data, ModData* mod)
+void calc_stats(unsigned int size, Vertices* data, Stats* stats)
+{
+	stats->supplies = total_supplies(size, data);
+	stats->max_slope_1d = max_slope_1d(size, data);
+	stats->max_slope = max_slope(size, data, &stats->slope);
+
+	count_dir_slope(size, data, &stats->dir_slope);
+	count_roughness(size, data, &stats->roughness);
+	count_position(size, data, &stats->position);
+}
+
+/*****************************/
+int mod_stats(unsigned int size, Vertices* data, ModData* mod)
 {
 	/* Get all the data */
-	unsigned int numS, numD, numR, numP;
-	unsigned int satS, unsatS;
-	unsigned int satD, unsatD;
-	unsigned int satR, unsatR;
-	unsigned int satP, unsatP;
-	float distS, distD, distR, distP;
-
-	float mSlope = max_slope(size, data, &numS, &satS, &unsatS, &distS);
-	count_dir_slope(size, data, &numD, &satD, &unsatD, &distD);
-	count_roughness(size, data, &numR, &satR, &unsatR, &distR);
-	count_position(size, data, &numP, &satP, &unsatP, &distP);
+	Stats st;
+	PERF_BEGIN(PERF_STATS);
+	calc_stats(size, data, &st);
+	PERF_END(PERF_STATS);
 
 	/* Output it */
 	output("");
 	output("-- TERRAIN STATS");
 	output("-- total points:   %u", size * size);
-	output("-- total supplies: %f", total_supplies(size, data));
-	output("-- max slope 1D:   %f", max_slope_1d(size, data));
-	output("-- max slope 2D:   %f", mSlope);
+	output("-- total supplies: %f", st.supplies);
+	output("-- max slope 1D:   %f", st.max_slope_1d);
+	output("-- max slope 2D:   %f", st.max_slope);
 	output("--");
 	output("-- Total constraints");
-	output("-- #slope:         %u", numS);
-	output("-- #directional:   %u", numD);
-	output("-- #roughness:     %u", numR);
-	output("-- #position:      %u", numP);
+	output("-- #slope:         %u", st.slope.count);
+	output("-- #directional:   %u", st.dir_slope.count);
+	output("-- #roughness:     %u", st.roughness.count);
+	output("-- #position:      %u", st.position.count);
 	output("--");
 	output("-- Satisfied constraints");
-	output("-- #slope:         %u", satS);
-	output("-- #directional:   %u", satD);
-	output("-- #roughness:     %u", satR);
-	output("-- #position:      %u", satP);
+	output("-- #slope:         %u", st.slope.satisfied);
+	output("-- #directional:   %u", st.dir_slope.satisfied);
+	output("-- #roughness:     %u", st.roughness.satisfied);
+	output("-- #position:      %u", st.position.satisfied);
 	output("--");
 	output("-- Unsatisfied constraints");
-	output("-- #slope:         %u", unsatS);
-	output("-- #directional:   %u", unsatD);
-	output("-- #roughness:     %u", unsatR);
-	output("-- #position:      %u", unsatP);
+	output("-- #slope:         %u", st.slope.unsatisfied);
+	output("-- #directional:   %u", st.dir_slope.unsatisfied);
+	output("-- #roughness:     %u", st.roughness.unsatisfied);
+	output("-- #position:      %u", st.position.unsatisfied);
 	output("--");
 	output("-- Average distance from goal");
-	output("-- slope:          %f", distS);
-	output("-- directional:    %f", distD);
-	output("-- roughness:      %f", distR);
-	output("-- position:       %f", distP);
+	output("-- slope:          %f", st.slope.distance);
+	output("-- directional:    %f", st.dir_slope.distance);
+	output("-- roughness:      %f", st.roughness.distance);
+	output("-- position:       %f", st.position.distance);
 
 	output("");
 
@@ -302,6 +286,7 @@ int mod_stats(unsigned int size, Vertex* data, ModData* mod)
 	/* Obviously only do this when an output file was given */
 	if(mod->out != NULL)
 	{
+		TRACE_BEGIN(write);
 		FILE* f = fopen(mod->out, "a");
 		if(f == NULL)
 			throw_error("Could not open file: %s", mod->out);
@@ -319,17 +304,26 @@ int mod_stats(unsigned int size, Vertex* data, ModData* mod)
 			/* s_s, s_d, s_r, s_p  Satisfied constraints */
 			/* u_s, u_d, u_r, u_p  Unsatisfied constraints */
 			/* d_s, d_d, d_r, d_p  Average distance from goal */
+			/* With USE_PERF_COUNTERS it is followed by a perf field, see perf.h */
 			fprintf(f,
 				"{ \"n_s\" : %u, \"n_d\" : %u, \"n_r\" : %u, \"n_p\" : %u,"
 				"  \"s_s\" : %u, \"s_d\" : %u, \"s_r\" : %u, \"s_p\" : %u,"
 				"  \"u_s\" : %u, \"u_d\" : %u, \"u_r\" : %u, \"u_p\" : %u,"
-				"  \"d_s\" : %f, \"d_d\" : %f, \"d_r\" : %f, \"d_p\" : %f }\n",
-				numS, numD, numR, numP,
-				satS, satD, satR, satP,
-				unsatS, unsatD, unsatR, unsatP,
-				distS, distD, distR, distP);
-
+				"  \"d_s\" : %f, \"d_d\" : %f, \"d_r\" : %f, \"d_p\" : %f",
+				st.slope.count, st.dir_slope.count,
+				st.roughness.count, st.position.count,
+				st.slope.satisfied, st.dir_slope.satisfied,
+				st.roughness.satisfied, st.position.satisfied,
+				st.slope.unsatisfied, st.dir_slope.unsatisfied,
+				st.roughness.unsatisfied, st.position.unsatisfied,
+				st.slope.distance, st.dir_slope.distance,
+				st.roughness.distance, st.position.distance);
+
+			PERF_WRITE(f);
+			fputs(" }\n", f);
 			fclose(f);
+			TRACE_END(write, "write_stats");
+
 			output("Terrain stats have been written to file: %s", mod->out);
 		}
 	}
@@ -3,6 +3,8 @@
 #include "modifiers.h"
 #include "output.h"
 #include "patch.h"
+#include "perf.h"
+#include "trace.h"
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
@@ -94,7 +96,7 @@ static void find_ellipse_intersect(
 /*****************************/
 static void flag_ellipse(
 	unsigned int size,
-	Vertex*      data,
+	Vertices*    data,
 	ANode        center,
 	float        rx,
 	float        ry,
@@ -117,15 +119,15 @@ static void flag_ellipse(
 			/* Check bounds + check if a slope constraint was already assigned */
 			if(cc < 0 || cc >= (int)size || rr < 0 || rr >= (int)size)
 				continue;
-			if(data[i].flags & SLOPE)
+			if(data->flags[i] & SLOPE)
 				continue;
 
 			/* Now check if it's inside our first ellipse */
 			float d = (c*(float)c) / (rx*rx) + (r*(float)r) / (ry*ry);
 			if(d <= 1)
 			{
-				data[i].c[0] = MAX_SLOPE;
-				data[i].flags = SLOPE;
+				data->c[0][i] = MAX_SLOPE;
+				data->flags[i] = SLOPE;
 			}
 
 			/* If not, it might be in our second ellipse */
@@ -148,15 +150,15 @@ static void flag_ellipse(
 				/* So it's not really linear anymore, otherwise it looks stupid... */
 				float dist = hypotf(tx, ty);
 				float nMaxSlope = MAX_SLOPE + MAX_SLOPE_FALLOFF * powf(dist, .5f);
-				float cMaxSlope = hypotf(data[i].c[0], data[i].c[1]);
+				float cMaxSlope = hypotf(data->c[0][i], data->c[1][i]);
 
 				/* If the slope is smaller than what is already stored, replace */
 				/* This so use the smallest distance to the path */
-				if(!(data[i].flags & DIR_SLOPE) || nMaxSlope < cMaxSlope)
+				if(!(data->flags[i] & DIR_SLOPE) || nMaxSlope < cMaxSlope)
 				{
-					data[i].c[0] = tx / dist * nMaxSlope;
-					data[i].c[1] = ty / dist * nMaxSlope;
-					data[i].flags = DIR_SLOPE;
+					data->c[0][i] = tx / dist * nMaxSlope;
+					data->c[1][i] = ty / dist * nMaxSlope;
+					data->flags[i] = DIR_SLOPE;
 				}
 			}
 		}
@@ -216,7 +218,7 @@ static void heapify_down(
 /*****************************/
 static int find_path(
 	unsigned int size,
-	Vertex*      data,
+	Vertices*    data,
 	ANode        start,
 	ANode        goal)
 {
@@ -271,6 +273,7 @@ static int find_path(
 		if(EQUAL(u, goal))
 		{
 			/* Flag the path from start to goal */
+			TRACE_BEGIN(flag);
 			float r = PATH_RADIUS / scale;
 			float b = PATH_INFLUENCE / scale;
 			while(!EQUAL(u, start))
@@ -281,6 +284,7 @@ static int find_path(
 
 			/* Don't forget to color the start */
 			flag_ellipse(size, data, start, r, r, b);
+			TRACE_END(flag, "flag_ellipse");
 
 			free(Q.data);
 			free(AND);
@@ -313,8 +317,8 @@ static int find_path(
 				/* Where the slope cost has a power and linear component */
 				float dist = D(u,v) * scale;
 				float slope = fabs(
-					(data[v.c * size + v.r].h -
-					data[u.c * size + u.r].h) / dist);
+					(data->h[v.c * size + v.r] -
+					data->h[u.c * size + u.r]) / dist);
 
 				float alt = COST(u) + dist * (1 + powf(slope, COST_POW) * COST_LIN);
 
@@ -348,7 +352,7 @@ static int find_path(
 }
 
 /*****************************/
-static void flag_borders(unsigned int size, Vertex* data, ModData* mod)
+static void flag_borders(unsigned int size, Vertices* data, ModData* mod)
 {
 	/* Loop over the local neighborhoud */
 	int c, r;
@@ -356,7 +360,7 @@ static void flag_borders(unsigned int size, Vertex* data, ModData* mod)
 		for(r = -1; r <= 1; ++r)
 		{
 			/* Check if there is a neighbour */
-			Vertex* hdata = mod->local[(c+1)*3+(r+1)];
+			float* hdata = mod->local[(c+1)*3+(r+1)];
 			if((c == 0 && r == 0) || !hdata)
 				continue;
 
@@ -382,8 +386,8 @@ static void flag_borders(unsigned int size, Vertex* data, ModData* mod)
 					(c ==  1 && r == -1) ? size-1 :
 					0;
 
-				data[id].flags |= POSITION;
-				data[id].c[2] = hdata[ih].h;
+				data->flags[id] |= POSITION;
+				data->c[2][id] = hdata[ih];
 			}
 
 			/* Handle edges */
@@ -403,8 +407,8 @@ static void flag_borders(unsigned int size, Vertex* data, ModData* mod)
 					(r == -1) ? i * size + (size-1) :
 					i * size;
 
-				data[id].flags |= POSITION;
-				data[id].c[2] = hdata[ih].h;
+				data->flags[id] |= POSITION;
+				data->c[2][id] = hdata[ih];
 
 				if(USE_BORDER_DERIV)
 				{
@@ -416,7 +420,7 @@ static void flag_borders(unsigned int size, Vertex* data, ModData* mod)
 						(r == -1) ? 1 : -1;
 
 					/* If the next vertex was already set, take the average */
-					int second = data[id+io].flags & POSITION;
+					int second = data->flags[id+io] & POSITION;
 
 					/* Now set the next vertex so the derivative is kept */
 					/* Well actually we take the average of its original position and the new one */
@@ -424,19 +428,19 @@ static void flag_borders(unsigned int size, Vertex* data, ModData* mod)
 					/* The new position being the new height based on derivative */
 					/* I don't know why this is just an experiment */
 					/* TODO: validate this in any way possible... */
-					data[id+io].flags |= POSITION;
-					data[id+io].c[2] += hdata[ih].h +
-						.5f * ((hdata[ih].h - hdata[ih-io].h) + (data[id+io].h - data[id].h));
+					data->flags[id+io] |= POSITION;
+					data->c[2][id+io] += hdata[ih] +
+						.5f * ((hdata[ih] - hdata[ih-io]) + (data->h[id+io] - data->h[id]));
 
 					/* So yeah that average */
-					if(second) data[id+io].c[2] *= .5f;
+					if(second) data->c[2][id+io] *= .5f;
 				}
 			}
 		}
 }
 
 /*****************************/
-int mod_subdivide(unsigned int size, Vertex* data, ModData* mod)
+int mod_subdivide(unsigned int size, Vertices* data, ModData* mod)
 {
 	float scale = GET_SCALE(size);
 
@@ -446,8 +450,8 @@ int mod_subdivide(unsigned int size, Vertex* data, ModData* mod)
 		unsigned int i;
 		for(i = 0; i < size*size; ++i)
 		{
-			data[i].c[0] = calc_roughness(size, data, i, scale);
-			data[i].flags = ROUGHNESS;
+			data->c[0][i] = calc_roughness(size, data->h, i, scale);
+			data->flags[i] = ROUGHNESS;
 		}
 	}
 
@@ -461,12 +465,16 @@ int mod_subdivide(unsigned int size, Vertex* data, ModData* mod)
 	ANode le = { .c = size * .2f, .r = size * .5f };
 	ANode ri = { .c = size * .8f, .r = size * .3f };
 
+	TRACE_BEGIN(flag);
 	flag_ellipse(size, data, bot, r, r, b);
 	flag_ellipse(size, data, top, r, r, b);
 	flag_ellipse(size, data, le, r * 3.0f, r * 2.5f, b);
 	flag_ellipse(size, data, ri, r * 2.8f, r * 2.0f, b);
+	TRACE_END(flag, "flag_ellipse");
 
 	/* Find a path from each node to the others */
+	TRACE_BEGIN(paths);
+	PERF_BEGIN(PERF_FIND_PATH);
 	if(!find_path(size, data, bot, le))
 		return 0;
 	if(!find_path(size, data, le, ri))
@@ -475,6 +483,8 @@ int mod_subdivide(unsigned int size, Vertex* data, ModData* mod)
 		return 0;
 	if(!find_path(size, data, ri, top))
 		return 0;
+	PERF_END(PERF_FIND_PATH);
+	TRACE_END(paths, "find_path");
 
 	/* Lastly, constrain the borders to match the neighbors */
 	/* It is important this is done last */
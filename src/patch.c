@@ -1,221 +1,545 @@
 
 #include "constants.h"
-#include "deps.h"
 #include "output.h"
 #include "patch.h"
+#include "pool.h"
+#include "timer.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 
 /*****************************/
-static int upload_vertex_data(Patch* patch)
+void read_mode(const char* str, ModMode* mode, Accel* accel)
 {
-	/* Temporary buffer to generate vertex data */
-	size_t vertSize = sizeof(float) * patch->size * patch->size * 9;
-	float* data = malloc(vertSize);
+	*mode =
+		str[0] == 'f' ? READ_FILE :
+		str[0] == 's' ? SEQUENTIAL :
+		str[0] == 'p' ? PARALLEL :
+		str[0] == 'g' ? GPU :
+		str[0] == 'c' ? COLORED :
+		str[0] == 'a' ? ACTIVE :
+		str[0] == 'm' ? MULTIGRID :
+		str[0] == 'd' ? DIRECT :
+		str[0] == 'e' ? ENVELOPE :
+		*mode;
+
+	accel->type = PLAIN;
+	accel->param = 0;
+
+	if(str[0] != '\0')
+	{
+		accel->type =
+			str[1] == 'r' ? OVER_RELAX :
+			str[1] == 'c' ? CHEBYSHEV :
+			PLAIN;
+		if(accel->type != PLAIN)
+			accel->param = atof(str + 2);
+	}
+
+	if(accel->type == CHEBYSHEV && *mode != PARALLEL)
+	{
+		output("Chebyshev acceleration only applies to parallel mode, it is ignored.");
+		accel->type = PLAIN;
+	}
+}
+
+/*****************************/
+int create_vertices(Vertices* data, unsigned int size)
+{
+	/* Allocate all arrays in one block, heights first */
+	/* 4 floats (h + constraints) and the flags per vertex */
+	size_t n = (size_t)size * size;
+	data->h = malloc((sizeof(float) * 4 + sizeof(unsigned char)) * n);
+
+	if(data->h == NULL)
+		return 0;
+
+	data->c[0] = data->h + n;
+	data->c[1] = data->c[0] + n;
+	data->c[2] = data->c[1] + n;
+	data->flags = (unsigned char*)(data->c[2] + n);
+
+	/* Initialize everything to zero */
+	memset(data->h, 0, (sizeof(float) * 4 + sizeof(unsigned char)) * n);
+
+	return 1;
+}
+
+/*****************************/
+void destroy_vertices(Vertices* data)
+{
+	free(data->h);
+	data->h = NULL;
+}
+
+/*****************************/
+int create_patch(Patch* patch, ModMode mode, Accel accel, unsigned int size)
+{
+	/* Allocate CPU memory */
+	glm_vec3_zero(patch->pos);
+	patch->size = size;
 
-	if(data == NULL)
+	if(!create_vertices(&patch->data, size))
 	{
-		throw_error("Failed to allocate memory to generate vertices.");
+		throw_error("Failed to allocate memory for a patch.");
 		return 0;
 	}
 
-	/* Now fill the vertex buffer */
-	/* Again, assumes column-major */
-	/* Columns = x, rows = y, height = z */
-	unsigned int c, r;
-	for(c = 0; c < patch->size; ++c)
-		for(r = 0; r < patch->size; ++r)
+	/* And the snapshots, all in one block as well */
+	size_t n = (size_t)size * size;
+	patch->snaps = malloc((sizeof(float) + sizeof(unsigned char)) * n * 3);
+
+	if(patch->snaps == NULL)
+	{
+		throw_error("Failed to allocate memory for patch snapshots.");
+		destroy_vertices(&patch->data);
+		return 0;
+	}
+
+	patch->back.h = patch->snaps;
+	patch->ready.h = patch->back.h + n;
+	patch->front.h = patch->ready.h + n;
+	patch->back.flags = (unsigned char*)(patch->front.h + n);
+	patch->ready.flags = patch->back.flags + n;
+	patch->front.flags = patch->ready.flags + n;
+
+	patch->mods = NULL;
+	patch->num_mods = 0;
+	patch->mode = mode;
+	patch->accel = accel;
+	patch->local = NULL;
+	patch->batch = NULL;
+
+	pthread_mutex_init(&patch->lock, NULL);
+	patch->has_worker = 0;
+	patch->quit = 0;
+	patch->done = 1;
+	patch->failed = 0;
+	patch->fresh = 0;
+
+	return 1;
+}
+
+/*****************************/
+static int all_mods_done(Patch* patch)
+{
+	int done = 1;
+	size_t m;
+	for(m = 0; m < patch->num_mods; ++m)
+		done &= patch->mods[m].done;
+
+	return done;
+}
+
+/*****************************/
+static int run_mods(Patch* patch, double budget, int* modded)
+{
+	double start = get_time();
+	double left = budget;
+	*modded = 0;
+
+	/* Loop over all modifiers, in order */
+	/* This makes it so modifiers only start when previous modifiers have finished */
+	/* Keep calling them for as long as there is time left */
+	size_t m = 0;
+	while(m < patch->num_mods && (left > 0 || !*modded))
+	{
+		ModData* data = patch->mods + m;
+		if(data->done)
 		{
-			unsigned int i = c * patch->size + r;
+			++m;
+			continue;
+		}
 
-			/* x, y and z */
-			data[i*9+0] = c;
-			data[i*9+1] = r;
-			data[i*9+2] = patch->data[i].h;
+		/* Ask for as many iterations as we expect to fit in the remaining time */
+		if(data->cost > 0)
+		{
+			double steps = left / data->cost;
+			data->steps =
+				(steps < 1) ? 1 :
+				(steps > MAX_STEP_SIZE) ? MAX_STEP_SIZE :
+				(unsigned int)steps;
+		}
 
-			/* Zero the associated normal */
-			glm_vec3_zero(data + (i*9+3));
+		/* If it's not done, call it! */
+		PatchModifier mod = (PatchModifier)data->mod;
+		unsigned int iterations = data->iterations;
+		double t = get_time();
 
-			/* Determine color from the flags */
-			int f = patch->data[i].flags;
-			data[i*9+6] = f & SLOPE ? 1 : f & DIR_SLOPE ? 1 : 0;
-			data[i*9+7] = f & SLOPE ? 0 : f & DIR_SLOPE ? 1 : 1;
-			data[i*9+8] = f & SLOPE ? 0 : f & DIR_SLOPE ? 0 : 0;
+		TRACE_BEGIN(mod);
+		if(!mod(patch->size, &patch->data, data))
+		{
+			throw_error("Could not update patch due to faulty modifier.");
+			return 0;
 		}
+		TRACE_END(mod, "modifier");
 
-	/* Calculate us some normal data */
-	/* Loop over all triangles and accumulate the normals */
-	for(c = 0; c < (patch->size-1); ++c)
-		for(r = 0; r < (patch->size-1); ++r)
+		*modded = 1;
+
+		/* Measure what an iteration cost, averaged with previous calls */
+		/* Modifiers that don't iterate are always done after one call anyway */
+		double now = get_time();
+		data->time += now - t;
+		iterations = data->iterations - iterations;
+		if(iterations > 0)
 		{
-			unsigned int iBL = c * patch->size + r;
-			unsigned int iTL = c * patch->size + r + 1;
-			unsigned int iBR = (c+1) * patch->size + r;
-			unsigned int iTR = (c+1) * patch->size + r + 1;
+			double cost = (now - t) / iterations;
+			data->cost = (data->cost > 0) ? (data->cost + cost) * .5 : cost;
+		}
 
-			/* Note we musn't forget to scale the height by the patch height */
-			vec3 x1 = { 1, 0, PATCH_HEIGHT * (data[iBR*9+2] - data[iBL*9+2]) };
-			vec3 y1 = { 0, 1, PATCH_HEIGHT * (data[iTL*9+2] - data[iBL*9+2]) };
-			vec3 x2 = { -1, 0, PATCH_HEIGHT * (data[iTL*9+2] - data[iTR*9+2]) };
-			vec3 y2 = { 0, -1, PATCH_HEIGHT * (data[iBR*9+2] - data[iTR*9+2]) };
+		left = budget - (now - start);
+	}
 
-			vec3 normal;
-			glm_vec3_crossn(x1, y1, normal);
-			glm_vec3_add(normal, data + (iBL*9+3), data + (iBL*9+3));
-			glm_vec3_add(normal, data + (iTL*9+3), data + (iTL*9+3));
-			glm_vec3_add(normal, data + (iBR*9+3), data + (iBR*9+3));
+	return 1;
+}
 
-			glm_vec3_crossn(x2, y2, normal);
-			glm_vec3_add(normal, data + (iTL*9+3), data + (iTL*9+3));
-			glm_vec3_add(normal, data + (iBR*9+3), data + (iBR*9+3));
-			glm_vec3_add(normal, data + (iTR*9+3), data + (iTR*9+3));
+/*****************************/
+static void publish_snapshot(Patch* patch)
+{
+	/* Copy into the back snapshot, nobody else looks at it */
+	TRACE_BEGIN(publish);
+	size_t n = patch->size * patch->size;
+	memcpy(patch->back.h, patch->data.h, sizeof(float) * n);
+	memcpy(patch->back.flags, patch->data.flags, sizeof(unsigned char) * n);
+
+	/* Then hand it over, whatever was ready but not picked up is overwritten next time */
+	pthread_mutex_lock(&patch->lock);
+	Snapshot t = patch->ready;
+	patch->ready = patch->back;
+	patch->back = t;
+	patch->fresh = 1;
+	pthread_mutex_unlock(&patch->lock);
+
+	TRACE_END(publish, "publish_snapshot");
+}
+
+/*****************************/
+static int run_slice(Patch* patch, int* failed)
+{
+	/* Run the modifiers for a slice of MOD_BUDGET and publish where we are */
+	/* Returns zero when there is nothing left to run */
+	int modded;
+	if(!run_mods(patch, MOD_BUDGET * 1e-3, &modded))
+	{
+		*failed = 1;
+		return 0;
+	}
+
+	if(modded)
+		publish_snapshot(patch);
+
+	return !all_mods_done(patch);
+}
+
+/*****************************/
+static int should_quit(Patch* patch)
+{
+	pthread_mutex_lock(&patch->lock);
+	int quit = patch->quit;
+	pthread_mutex_unlock(&patch->lock);
+
+	return quit;
+}
+
+/*****************************/
+static void finish_patch(Patch* patch, int failed)
+{
+	pthread_mutex_lock(&patch->lock);
+	patch->done = 1;
+	patch->failed = failed;
+	pthread_mutex_unlock(&patch->lock);
+}
+
+/*****************************/
+static void* run_worker(void* arg)
+{
+	Patch* patch = arg;
+	int failed = 0;
+
+	TRACE_THREAD("patch");
+
+	/* Run slice after slice, and check if we should stop in between */
+	while(!should_quit(patch) && run_slice(patch, &failed));
+	finish_patch(patch, failed);
+
+	return NULL;
+}
+
+/*****************************/
+static double estimate_slice(Patch* patch)
+{
+	/* Estimated seconds the next slice of a patch takes */
+	/* Iterative modifiers fill the budget, unless even MAX_STEP_SIZE iterations don't */
+	/* If nothing is known yet, e.g. the modifier didn't run yet, assume the whole budget */
+	double budget = MOD_BUDGET * 1e-3;
+	size_t m;
+	for(m = 0; m < patch->num_mods; ++m)
+		if(!patch->mods[m].done)
+		{
+			double cost = patch->mods[m].cost * MAX_STEP_SIZE;
+			return (cost > 0 && cost < budget) ? cost : budget;
 		}
 
-	/* So we're going to override the normals at the borders */
-	/* This so when the borders of patches are stitched, so are the normals */
-	/* It's kind of a cheat but oh well... */
-	/* TODO: Maybe improve the border constraint so the first derivative is kept */
-	/* i.e. the point besides the border is also position constrained */
-	/* I did this... not sure if it's useful */
-	/* TODO: Decide if either this or the derivative constraint is useful */
-	for(r = 0; r < patch->size; ++r)
+	return 0;
+}
+
+/*****************************/
+static int compare_slices(const void* a, const void* b)
+{
+	/* Longest first */
+	double la = estimate_slice(*(Patch* const*)a);
+	double lb = estimate_slice(*(Patch* const*)b);
+
+	return (la < lb) - (la > lb);
+}
+
+/*****************************/
+static void run_batch_slice(unsigned int i, void* data)
+{
+	/* A patch is only in a round once, so its modifiers still run one after the other */
+	Patch* patch = ((Patch**)data)[i];
+	if(should_quit(patch))
+		return;
+
+	int failed = 0;
+	if(!run_slice(patch, &failed))
+		finish_patch(patch, failed);
+}
+
+/*****************************/
+static void* run_batch(void* arg)
+{
+	PatchBatch* batch = arg;
+	size_t capacity = 0;
+
+	TRACE_THREAD("batch");
+
+	pthread_mutex_lock(&batch->lock);
+
+	for(;;)
 	{
-		data[r*9+3] = 0.0f;
-		data[((patch->size-1)*patch->size+r)*9+3] = 0.0f;
-		data[(r*patch->size)*9+4] = 0.0f;
-		data[(r*patch->size+patch->size-1)*9+4] = 0.0f;
+		while(!batch->quit && batch->count == 0)
+			pthread_cond_wait(&batch->wake, &batch->lock);
+
+		if(batch->quit)
+			break;
+
+		/* Take all patches for this round, more may join while it runs */
+		if(capacity < batch->count)
+		{
+			Patch** round = realloc(batch->round, sizeof(Patch*) * batch->capacity);
+			if(round != NULL)
+			{
+				batch->round = round;
+				capacity = batch->capacity;
+			}
+		}
+
+		unsigned int count = (batch->count < capacity) ? batch->count : capacity;
+
+		/* Start the longest slices first, so the short ones fill up the gaps at the end */
+		memcpy(batch->round, batch->patches, sizeof(Patch*) * count);
+		qsort(batch->round, count, sizeof(Patch*), compare_slices);
+		batch->round_count = count;
+		pthread_mutex_unlock(&batch->lock);
+
+		TRACE_BEGIN(round);
+		pool_run(count, run_batch_slice, batch->round);
+		TRACE_END(round, "batch_round");
+
+		/* Patches that are done or asked to stop leave the batch */
+		pthread_mutex_lock(&batch->lock);
+
+		size_t i, j = 0;
+		for(i = 0; i < batch->count; ++i)
+		{
+			Patch* p = batch->patches[i];
+			pthread_mutex_lock(&p->lock);
+			int leave = p->done || p->quit;
+			pthread_mutex_unlock(&p->lock);
+
+			if(!leave)
+				batch->patches[j++] = p;
+		}
+
+		batch->count = j;
+		batch->round_count = 0;
+		pthread_cond_broadcast(&batch->wake);
+
+		/* If no memory for a round could be had, nothing ran, don't keep trying at once */
+		if(count == 0)
+			pthread_cond_wait(&batch->wake, &batch->lock);
 	}
 
-	/* Now just normalize 'm all */
-	for(c = 0; c < patch->size; ++c)
-		for(r = 0; r < patch->size; ++r)
+	pthread_mutex_unlock(&batch->lock);
+
+	return NULL;
+}
+
+/*****************************/
+static int join_batch(Patch* patch)
+{
+	PatchBatch* batch = patch->batch;
+	pthread_mutex_lock(&batch->lock);
+
+	if(batch->count == batch->capacity)
+	{
+		size_t capacity = batch->capacity ? batch->capacity * 2 : 16;
+		Patch** patches = realloc(batch->patches, sizeof(Patch*) * capacity);
+
+		if(patches == NULL)
 		{
-			unsigned int i = c * patch->size + r;
-			glm_vec3_normalize(data + (i*9+3));
+			pthread_mutex_unlock(&batch->lock);
+			return 0;
 		}
 
-	glBindBuffer(GL_ARRAY_BUFFER, patch->vertices);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, vertSize, data);
-	free(data);
+		batch->patches = patches;
+		batch->capacity = capacity;
+	}
+
+	batch->patches[batch->count++] = patch;
+	pthread_cond_broadcast(&batch->wake);
+	pthread_mutex_unlock(&batch->lock);
 
 	return 1;
 }
 
 /*****************************/
-int create_patch(Patch* patch, ModMode mode, unsigned int size)
+static int in_batch(Patch** patches, size_t count, Patch* patch)
 {
-	/* Allocate CPU memory */
-	size_t vertSize = sizeof(Vertex) * size * size;
-	glm_vec3_zero(patch->pos);
-	patch->size = size;
-	patch->data = malloc(vertSize);
+	size_t i;
+	for(i = 0; i < count; ++i)
+		if(patches[i] == patch)
+			return 1;
 
-	if(patch->data == NULL)
+	return 0;
+}
+
+/*****************************/
+static void leave_batch(Patch* patch)
+{
+	/* Skip its slice if the current round didn't get to it yet */
+	/* The batch drops it after the round, then it won't touch it anymore */
+	PatchBatch* batch = patch->batch;
+	pthread_mutex_lock(&patch->lock);
+	patch->quit = 1;
+	pthread_mutex_unlock(&patch->lock);
+
+	pthread_mutex_lock(&batch->lock);
+	while(in_batch(batch->patches, batch->count, patch) ||
+		in_batch(batch->round, batch->round_count, patch))
 	{
-		throw_error("Failed to allocate memory for a patch.");
-		return 0;
+		pthread_cond_wait(&batch->wake, &batch->lock);
 	}
 
-	patch->mods = NULL;
-	patch->num_mods = 0;
-	patch->mode = mode;
+	pthread_mutex_unlock(&batch->lock);
 
-	/* Initialize everything to zero */
-	memset(patch->data, 0, vertSize);
-
-	/* Allocate GPU memory and setup VAO */
-	glGenVertexArrays(1, &patch->vao);
-	glGenBuffers(1, &patch->vertices);
-	glGenBuffers(1, &patch->indices);
-
-	glBindBuffer(GL_ARRAY_BUFFER, patch->vertices);
-	glBufferData(GL_ARRAY_BUFFER, vertSize * 9, NULL, GL_STATIC_DRAW);
-
-	/* So we have 3 floats for the position, normal and color */
-	GLsizei attrSize = sizeof(float) * 3;
-	glBindVertexArray(patch->vao);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-
-	glVertexAttribPointer(
-		0, 3, GL_FLOAT, GL_FALSE, attrSize * 3, (GLvoid*)0);
-	glVertexAttribPointer(
-		1, 3, GL_FLOAT, GL_FALSE, attrSize * 3, (GLvoid*)(uintptr_t)attrSize);
-	glVertexAttribPointer(
-		2, 3, GL_FLOAT, GL_FALSE, attrSize * 3, (GLvoid*)(uintptr_t)(attrSize*2));
-
-	/* Generate some index data */
-	size_t indSize = sizeof(unsigned int) * 6 * (size-1) * (size-1);
-	unsigned int* ind = malloc(indSize);
-
-	if(ind == NULL)
+	/* It is done, but keep whether it failed as the batch left it */
+	pthread_mutex_lock(&patch->lock);
+	patch->done = 1;
+	pthread_mutex_unlock(&patch->lock);
+}
+
+/*****************************/
+static void stop_worker(Patch* patch)
+{
+	if(!patch->has_worker)
+		return;
+
+	/* Ask it to stop after its current slice and wait for it */
+	if(patch->batch)
+		leave_batch(patch);
+	else
 	{
-		throw_error("Failed to allocate memory to generate indices.");
-		destroy_patch(patch);
+		pthread_mutex_lock(&patch->lock);
+		patch->quit = 1;
+		pthread_mutex_unlock(&patch->lock);
 
-		return 0;
+		pthread_join(patch->worker, NULL);
 	}
 
-	/* Loop over all squares inbetween vertices, add two triangles */
-	/* Assumes the vertices are stored column-major */
-	unsigned int i, c, r;
-	for(i = 0, c = 0; c < (size-1); ++c)
-		for(r = 0; r < (size-1); ++r)
-		{
-			/* To the right being x, upwards being y: */
-			/* bottom left, top left, bottom right */
-			ind[i++] = c * size + r;
-			ind[i++] = c * size + r + 1;
-			ind[i++] = (c+1) * size + r;
-
-			/* top left, top right, bottom right */
-			ind[i++] = c * size + r + 1;
-			ind[i++] = (c+1) * size + r + 1;
-			ind[i++] = (c+1) * size + r;
-		}
+	patch->has_worker = 0;
+	patch->quit = 0;
+}
+
+/*****************************/
+int create_patch_batch(PatchBatch* batch)
+{
+	batch->patches = NULL;
+	batch->count = 0;
+	batch->capacity = 0;
+	batch->round = NULL;
+	batch->round_count = 0;
+	batch->quit = 0;
+
+	pthread_mutex_init(&batch->lock, NULL);
+	pthread_cond_init(&batch->wake, NULL);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patch->indices);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indSize, ind, GL_STATIC_DRAW);
-	free(ind);
+	if(pthread_create(&batch->worker, NULL, run_batch, batch))
+	{
+		throw_error("Could not create a worker thread for the batch.");
+		pthread_mutex_destroy(&batch->lock);
+		pthread_cond_destroy(&batch->wake);
+		return 0;
+	}
 
 	return 1;
 }
 
 /*****************************/
-void destroy_patch(Patch* patch)
+void destroy_patch_batch(PatchBatch* batch)
 {
-	glDeleteVertexArrays(1, &patch->vao);
-	glDeleteBuffers(1, &patch->vertices);
-	glDeleteBuffers(1, &patch->indices);
+	pthread_mutex_lock(&batch->lock);
+	batch->quit = 1;
+	pthread_cond_broadcast(&batch->wake);
+	pthread_mutex_unlock(&batch->lock);
+
+	pthread_join(batch->worker, NULL);
+
+	pthread_mutex_destroy(&batch->lock);
+	pthread_cond_destroy(&batch->wake);
+	free(batch->patches);
+	free(batch->round);
+	batch->patches = NULL;
+	batch->round = NULL;
+}
 
-	/* Destroy all modifiers */
+/*****************************/
+static void destroy_mods(Patch* patch)
+{
 	size_t m;
 	for(m = 0; m < patch->num_mods; ++m)
 	{
-		free(patch->mods[m].snap);
 		free(patch->mods[m].buffer);
+		free(patch->mods[m].work);
 	}
 
 	free(patch->mods);
-	free(patch->data);
-
-	/* So is_patch will return 0 */
-	patch->data = NULL;
+	free(patch->local);
+	patch->mods = NULL;
+	patch->num_mods = 0;
+	patch->local = NULL;
 }
 
 /*****************************/
-int is_patch(Patch* patch)
+void destroy_patch(Patch* patch)
 {
-	return patch->data != NULL;
+	/* First make sure nothing is running anymore */
+	stop_worker(patch);
+	pthread_mutex_destroy(&patch->lock);
+
+	/* Destroy all modifiers */
+	destroy_mods(patch);
+	free(patch->snaps);
+
+	/* So is_patch will return 0 */
+	destroy_vertices(&patch->data);
 }
 
 /*****************************/
-void draw_patch(Patch* patch)
+int is_patch(Patch* patch)
 {
-	glBindVertexArray(patch->vao);
-	size_t elems = 6 * (patch->size-1) * (patch->size-1);
-	glDrawElements(GL_TRIANGLES, elems, GL_UNSIGNED_INT, (GLvoid*)0);
+	return patch->data.h != NULL;
 }
 
 /*****************************/
@@ -226,14 +550,9 @@ int populate_patch(
 	const char**   outs,
 	Patch*         local[])
 {
-	/* Destroy the current modifiers */
-	size_t m;
-	for(m = 0; m < patch->num_mods; ++m)
-		free(patch->mods[m].buffer);
-
-	free(patch->mods);
-	patch->mods = NULL;
-	patch->num_mods = 0;
+	/* Stop and destroy the current modifiers */
+	stop_worker(patch);
+	destroy_mods(patch);
 
 	/* First count the number of new modifiers */
 	while(mods && mods[patch->num_mods])
@@ -242,96 +561,221 @@ int populate_patch(
 	if(patch->num_mods)
 	{
 		/* Now allocate new modifiers */
+		/* And room to copy the heights of the local neighbourhood to */
+		/* Their workers keep changing them, so we can't just read them later on */
+		size_t n = patch->size * patch->size;
 		patch->mods = malloc(sizeof(ModData) * patch->num_mods);
-		if(!patch->mods)
+		patch->local = local ? malloc(sizeof(float) * n * 9) : NULL;
+
+		if(!patch->mods || (local && !patch->local))
 		{
 			throw_error("Could not allocate memory for new modifier data.");
-			patch->num_mods = 0;
+			destroy_mods(patch);
 			return 0;
 		}
 
+		/* If we have local neighbourhood data, grab their heights */
+		/* Take the latest snapshot, front is ours as we're on the render thread */
+		/* While we're at it, check that their size is equivalent */
+		float* heights[9];
+		unsigned int l;
+		for(l = 0; l < 9; ++l)
+		{
+			Patch* p = local ? local[l] : NULL;
+			heights[l] = NULL;
+
+			if(p == patch)
+				heights[l] = patch->data.h;
+
+			else if(p && p->size == patch->size)
+			{
+				heights[l] = patch->local + n * l;
+
+				pthread_mutex_lock(&p->lock);
+				memcpy(heights[l], p->fresh ? p->ready.h : p->front.h, sizeof(float) * n);
+				pthread_mutex_unlock(&p->lock);
+			}
+		}
+
 		/* Initialize the new modifiers */
+		size_t m;
 		for(m = 0; m < patch->num_mods; ++m)
 		{
 			patch->mods[m].mod        = mods[m];
 			patch->mods[m].mode       = patch->mode;
-			patch->mods[m].snap       = NULL;
+			patch->mods[m].accel      = patch->accel;
 			patch->mods[m].done       = 0;
+			patch->mods[m].converged  = 0;
 			patch->mods[m].iterations = 0;
+			patch->mods[m].steps      = 0;
+			patch->mods[m].cost       = 0;
+			patch->mods[m].time       = 0;
 			patch->mods[m].buffer     = NULL;
+			patch->mods[m].work       = NULL;
 
 			if(outs)
 				patch->mods[m].out = outs[m];
 			else
 				patch->mods[m].out = NULL;
 
-			/* If we have local neighbourhood data, grab their vertex data */
-			/* While we're at it, check that their size is equivalent */
-			unsigned int n;
-			for(n = 0; n < 9; ++n)
-			{
-				if(local && local[n] && local[n]->size == patch->size)
-					patch->mods[m].local[n] = local[n]->data;
-				else
-					patch->mods[m].local[n] = NULL;
-			}
+			memcpy(patch->mods[m].local, heights, sizeof(heights));
 		}
 	}
 
 	/* Generate the terrain */
-	if(!generator(patch->size, patch->data))
+	if(!generator(patch->size, &patch->data))
 	{
 		throw_error("Could not populate patch due to faulty generation.");
 		return 0;
 	}
 
-	/* Upload it to the GPU */
-	return upload_vertex_data(patch);
-}
+	/* It's what the front snapshot shows until the modifiers publish something */
+	size_t n = patch->size * patch->size;
+	memcpy(patch->front.h, patch->data.h, sizeof(float) * n);
+	memcpy(patch->front.flags, patch->data.flags, sizeof(unsigned char) * n);
 
-/*****************************/
-int update_patch(Patch* patch)
-{
-	int modded = 0;
+	/* And start modifying it in the background */
+	patch->done = (patch->num_mods == 0);
+	patch->failed = 0;
+	patch->fresh = 0;
 
-	/* Loop over all modifiers */
-	size_t m;
-	for(m = 0; m < patch->num_mods; ++m)
+	if(!patch->done && patch->batch)
 	{
-		if(patch->mods[m].done)
-			continue;
+		if(!join_batch(patch))
+		{
+			throw_error("Could not add the patch to its batch.");
+			patch->done = 1;
+			return 0;
+		}
 
-		/* If it's not done, call it! */
-		PatchModifier mod = (PatchModifier)patch->mods[m].mod;
-		if(!mod(patch->size, patch->data, patch->mods + m))
+		patch->has_worker = 1;
+	}
+
+	else if(!patch->done)
+	{
+		if(pthread_create(&patch->worker, NULL, run_worker, patch))
 		{
-			throw_error("Could not update patch due to faulty modifier.");
+			throw_error("Could not create a worker thread for the patch.");
+			patch->done = 1;
 			return 0;
 		}
 
-		modded = 1;
+		patch->has_worker = 1;
+	}
 
-		/* If it's still not done, halt */
-		/* This makes it so modifiers only start when previous modifiers have finished */
-		if(!patch->mods[m].done)
-			break;
+	return 1;
+}
+
+/*****************************/
+int update_patch(Patch* patch, int* fresh)
+{
+	/* Grab the ready snapshot if it's new */
+	pthread_mutex_lock(&patch->lock);
+	int isFresh = patch->fresh;
+	int failed = patch->failed;
+
+	if(isFresh)
+	{
+		Snapshot t = patch->front;
+		patch->front = patch->ready;
+		patch->ready = t;
+		patch->fresh = 0;
 	}
 
-	/* If no modification has been applied, we're done */
-	/* Otherwise we go ahead and upload new vertex data */
-	if(!modded)
-		return 1;
+	pthread_mutex_unlock(&patch->lock);
 
-	return upload_vertex_data(patch);
+	if(fresh)
+		*fresh = isFresh;
+
+	return !failed;
 }
 
 /*****************************/
 int is_patch_done(Patch* patch)
 {
-	int done = 1;
-	size_t m;
-	for(m = 0; m < patch->num_mods; ++m)
-		done &= patch->mods[m].done;
+	/* Done means the last snapshot has been uploaded as well */
+	pthread_mutex_lock(&patch->lock);
+	int done = patch->done && !patch->fresh;
+	pthread_mutex_unlock(&patch->lock);
 
 	return done;
 }
+
+/*****************************/
+void build_snapshot_vertices(unsigned int size, Snapshot* snap, float* out)
+{
+	/* Fill in the position and color of all vertices */
+	/* Assumes column-major */
+	/* Columns = x, rows = y, height = z */
+	unsigned int c, r;
+	for(c = 0; c < size; ++c)
+		for(r = 0; r < size; ++r)
+		{
+			unsigned int i = c * size + r;
+
+			/* x, y and z */
+			out[i*9+0] = c;
+			out[i*9+1] = r;
+			out[i*9+2] = snap->h[i];
+
+			/* Zero the associated normal */
+			glm_vec3_zero(out + (i*9+3));
+
+			/* Determine color from the flags */
+			int f = snap->flags[i];
+			out[i*9+6] = f & SLOPE ? 1 : f & DIR_SLOPE ? 1 : 0;
+			out[i*9+7] = f & SLOPE ? 0 : f & DIR_SLOPE ? 1 : 1;
+			out[i*9+8] = f & SLOPE ? 0 : f & DIR_SLOPE ? 0 : 0;
+		}
+
+	/* Calculate us some normal data */
+	/* Loop over all triangles and accumulate the normals */
+	for(c = 0; c < (size-1); ++c)
+		for(r = 0; r < (size-1); ++r)
+		{
+			unsigned int iBL = c * size + r;
+			unsigned int iTL = c * size + r + 1;
+			unsigned int iBR = (c+1) * size + r;
+			unsigned int iTR = (c+1) * size + r + 1;
+
+			/* Note we musn't forget to scale the height by the patch height */
+			vec3 x1 = { 1, 0, PATCH_HEIGHT * (out[iBR*9+2] - out[iBL*9+2]) };
+			vec3 y1 = { 0, 1, PATCH_HEIGHT * (out[iTL*9+2] - out[iBL*9+2]) };
+			vec3 x2 = { -1, 0, PATCH_HEIGHT * (out[iTL*9+2] - out[iTR*9+2]) };
+			vec3 y2 = { 0, -1, PATCH_HEIGHT * (out[iBR*9+2] - out[iTR*9+2]) };
+
+			vec3 normal;
+			glm_vec3_crossn(x1, y1, normal);
+			glm_vec3_add(normal, out + (iBL*9+3), out + (iBL*9+3));
+			glm_vec3_add(normal, out + (iTL*9+3), out + (iTL*9+3));
+			glm_vec3_add(normal, out + (iBR*9+3), out + (iBR*9+3));
+
+			glm_vec3_crossn(x2, y2, normal);
+			glm_vec3_add(normal, out + (iTL*9+3), out + (iTL*9+3));
+			glm_vec3_add(normal, out + (iBR*9+3), out + (iBR*9+3));
+			glm_vec3_add(normal, out + (iTR*9+3), out + (iTR*9+3));
+		}
+
+	/* So we're going to override the normals at the borders */
+	/* This so when the borders of patches are stitched, so are the normals */
+	/* It's kind of a cheat but oh well... */
+	/* TODO: Maybe improve the border constraint so the first derivative is kept */
+	/* i.e. the point besides the border is also position constrained */
+	/* I did this... not sure if it's useful */
+	/* TODO: Decide if either this or the derivative constraint is useful */
+	for(r = 0; r < size; ++r)
+	{
+		out[r*9+3] = 0.0f;
+		out[((size-1)*size+r)*9+3] = 0.0f;
+		out[(r*size)*9+4] = 0.0f;
+		out[(r*size+size-1)*9+4] = 0.0f;
+	}
+
+	/* Now just normalize 'm all */
+	for(c = 0; c < size; ++c)
+		for(r = 0; r < size; ++r)
+		{
+			unsigned int i = c * size + r;
+			glm_vec3_normalize(out + (i*9+3));
+		}
+}
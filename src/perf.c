@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+
+#include "output.h"
+#include "perf.h"
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* The counters of each phase */
+#define PERF_COUNTERS 5
+
+static const char* counter_names[PERF_COUNTERS] = {
+	"cycles",
+	"instructions",
+	"l1d_misses",
+	"llc_misses",
+	"branch_misses"
+};
+
+static const char* phase_names[PERF_PHASES] = {
+	"sweep",
+	"position",
+	"find_path",
+	"stats"
+};
+
+
+/* A reading of the whole group, as read() returns it with PERF_FORMAT_GROUP */
+typedef struct
+{
+	unsigned long long nr;
+	unsigned long long enabled;
+	unsigned long long running;
+	unsigned long long values[PERF_COUNTERS];
+
+} PerfReading;
+
+
+/* Counts of a phase, summed over all its calls */
+typedef struct
+{
+	unsigned int calls;
+	double       values[PERF_COUNTERS];
+
+} PerfTotals;
+
+
+/* Counters of the current thread, opened the first time they are needed */
+static __thread struct
+{
+	int          state;                  /* 0 unopened, 1 open, -1 unavailable */
+	int          leader;                 /* File descriptor of the group */
+	int          slots[PERF_COUNTERS];   /* Index in the group, -1 if unavailable */
+	PerfReading  start[PERF_PHASES];
+	PerfTotals   totals[PERF_PHASES];
+
+} perf;
+
+/* Only warn once that there are no counters */
+static pthread_once_t warned = PTHREAD_ONCE_INIT;
+
+
+/*****************************/
+static void warn_perf(void)
+{
+	output("No hardware performance counters available, perf stats are null.");
+}
+
+/*****************************/
+static void init_attr(unsigned int c, struct perf_event_attr* attr)
+{
+	memset(attr, 0, sizeof(struct perf_event_attr));
+	attr->size = sizeof(struct perf_event_attr);
+	attr->read_format = PERF_FORMAT_GROUP |
+		PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	/* User space only, that's all we care about and is allowed most often */
+	attr->exclude_kernel = 1;
+	attr->exclude_hv = 1;
+
+	switch(c)
+	{
+	case 0:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case 1:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case 2:
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = PERF_COUNT_HW_CACHE_L1D |
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case 3:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	default:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	}
+}
+
+/*****************************/
+static void open_perf(void)
+{
+	/* Open all counters as one group, so they are scheduled together */
+	/* The first one that opens leads the group, any that fail are left out */
+	perf.state = -1;
+	perf.leader = -1;
+
+	unsigned int c, n = 0;
+	for(c = 0; c < PERF_COUNTERS; ++c)
+	{
+		struct perf_event_attr attr;
+		init_attr(c, &attr);
+
+		int fd = syscall(SYS_perf_event_open, &attr, 0, -1, perf.leader, 0);
+		perf.slots[c] = (fd < 0) ? -1 : (int)n++;
+
+		if(fd >= 0 && perf.leader < 0)
+			perf.leader = fd;
+	}
+
+	if(perf.leader < 0)
+	{
+		pthread_once(&warned, warn_perf);
+		return;
+	}
+
+	ioctl(perf.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(perf.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	perf.state = 1;
+}
+
+/*****************************/
+static int read_perf(PerfReading* r)
+{
+	if(perf.state == 0)
+		open_perf();
+	if(perf.state < 0)
+		return 0;
+
+	return read(perf.leader, r, sizeof(PerfReading)) > 0;
+}
+
+/*****************************/
+void begin_perf(PerfPhase phase)
+{
+	if(!read_perf(perf.start + phase))
+		perf.start[phase].nr = 0;
+}
+
+/*****************************/
+void end_perf(PerfPhase phase)
+{
+	PerfReading end;
+	PerfReading* start = perf.start + phase;
+
+	if(start->nr == 0 || !read_perf(&end))
+		return;
+
+	/* If the group was multiplexed with others, scale up to the whole time */
+	double running = end.running - start->running;
+	double scale = running > 0 ? (end.enabled - start->enabled) / running : 0;
+
+	PerfTotals* t = perf.totals + phase;
+	++t->calls;
+
+	unsigned int c;
+	for(c = 0; c < PERF_COUNTERS; ++c)
+		if(perf.slots[c] >= 0)
+			t->values[c] += (end.values[perf.slots[c]] - start->values[perf.slots[c]]) * scale;
+}
+
+/*****************************/
+void write_perf(FILE* f)
+{
+	/* Make sure we know whether there are counters at all */
+	if(perf.state == 0)
+		open_perf();
+
+	if(perf.state < 0)
+	{
+		fputs(", \"perf\" : null", f);
+		return;
+	}
+
+	/* An object per phase, with a field per counter */
+	/* ipc is instructions per cycle, unavailable counters are null */
+	fputs(", \"perf\" : {", f);
+
+	unsigned int p, c;
+	for(p = 0; p < PERF_PHASES; ++p)
+	{
+		PerfTotals* t = perf.totals + p;
+		fprintf(f, "%s \"%s\" : { \"calls\" : %u", p ? "," : "", phase_names[p], t->calls);
+
+		for(c = 0; c < PERF_COUNTERS; ++c)
+			if(perf.slots[c] >= 0)
+				fprintf(f, ", \"%s\" : %.0f", counter_names[c], t->values[c]);
+			else
+				fprintf(f, ", \"%s\" : null", counter_names[c]);
+
+		if(perf.slots[0] >= 0 && perf.slots[1] >= 0 && t->values[0] > 0)
+			fprintf(f, ", \"ipc\" : %f }", t->values[1] / t->values[0]);
+		else
+			fputs(", \"ipc\" : null }", f);
+	}
+
+	fputs(" }", f);
+
+	/* Each record holds the counts since the previous one */
+	memset(perf.totals, 0, sizeof(perf.totals));
+}
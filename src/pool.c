@@ -0,0 +1,682 @@
+#include "constants.h"
+#include "output.h"
+#include "pool.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Initial number of ranges a queue can hold, it grows as needed */
+#define QUEUE_SIZE 64
+
+
+/* Progress of a task graph */
+typedef struct PoolGraphRun PoolGraphRun;
+
+
+/* The tasks of a single call to pool_run or pool_for, or of a graph node */
+typedef struct
+{
+	PoolTask      task;      /* Either task or range is set */
+	PoolRangeTask range;
+	void*         data;
+	unsigned int  grain;     /* Maximum number of indices to run at once */
+	unsigned int  remaining; /* Indices that are not yet finished, protected by pool.lock */
+	PoolGraphRun* graph;     /* Graph it is a node of, can be NULL */
+
+} PoolJob;
+
+
+struct PoolGraphRun
+{
+	PoolNode*     nodes;
+	PoolJob*      jobs;
+	unsigned int* pending;   /* Dependencies that are not yet done, per node */
+	unsigned int* next;      /* Nodes depending on each node, see offsets */
+	unsigned int* offsets;   /* Node i has next[offsets[i]] up to next[offsets[i+1]] */
+	unsigned int  remaining; /* Nodes that are not yet done */
+};
+
+
+/* Indices of a job that are not yet started, what gets queued and stolen */
+typedef struct
+{
+	PoolJob*     job;
+	unsigned int begin;
+	unsigned int end;
+
+} PoolRange;
+
+
+/* Queue of a thread, it pops its own work from the back */
+/* Others steal from the front, which holds the biggest ranges */
+typedef struct
+{
+	pthread_mutex_t lock;
+	PoolRange*      ranges;
+	unsigned int    front;
+	unsigned int    back;
+	unsigned int    capacity;
+
+} PoolQueue;
+
+
+/* The one and only thread pool */
+static struct
+{
+	pthread_t*      threads;
+	PoolQueue*      queues;      /* One per thread, 0 is shared by all threads outside the pool */
+	unsigned int    num_queues;
+	unsigned int    num_threads; /* Including the thread calling pool_run, 0 if not created */
+
+	pthread_mutex_t create;   /* Held while creating or destroying the pool */
+	pthread_mutex_t lock;     /* Protects everything below and all job counters */
+	pthread_cond_t  wake;     /* Signals new work, finished jobs or termination */
+
+	unsigned int    epoch;    /* Incremented on every signal, so nothing is missed */
+	unsigned int    sleeping; /* Threads waiting on wake */
+	int             quit;
+
+} pool = {
+	.threads     = NULL,
+	.queues      = NULL,
+	.num_queues  = 0,
+	.num_threads = 0,
+	.create      = PTHREAD_MUTEX_INITIALIZER,
+	.lock        = PTHREAD_MUTEX_INITIALIZER,
+	.wake        = PTHREAD_COND_INITIALIZER
+};
+
+/* Queue of the current thread, 0 for all threads outside the pool */
+static __thread unsigned int queue = 0;
+
+/* Scratch memory of each thread */
+static pthread_key_t scratch;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+
+/*****************************/
+static void signal_pool(void)
+{
+	pthread_mutex_lock(&pool.lock);
+	++pool.epoch;
+	if(pool.sleeping)
+		pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*****************************/
+static int push_range(PoolJob* job, unsigned int begin, unsigned int end)
+{
+	if(queue >= pool.num_queues)
+		return 0;
+
+	PoolQueue* q = pool.queues + queue;
+	pthread_mutex_lock(&q->lock);
+
+	/* Make room at the back, first by moving everything to the front */
+	if(q->back == q->capacity && q->front > 0)
+	{
+		unsigned int i;
+		for(i = q->front; i < q->back; ++i)
+			q->ranges[i - q->front] = q->ranges[i];
+
+		q->back -= q->front;
+		q->front = 0;
+	}
+
+	if(q->back == q->capacity)
+	{
+		unsigned int capacity = q->capacity * 2;
+		PoolRange* ranges = realloc(q->ranges, sizeof(PoolRange) * capacity);
+		if(ranges == NULL)
+		{
+			pthread_mutex_unlock(&q->lock);
+			return 0;
+		}
+
+		q->ranges = ranges;
+		q->capacity = capacity;
+	}
+
+	PoolRange* r = q->ranges + q->back++;
+	r->job = job;
+	r->begin = begin;
+	r->end = end;
+
+	pthread_mutex_unlock(&q->lock);
+	signal_pool();
+
+	return 1;
+}
+
+/*****************************/
+static int is_owned(const void* owner, PoolJob* job)
+{
+	/* Owned by a job itself, or the graph it is a node of, anything if NULL */
+	return owner == NULL || owner == job || owner == job->graph;
+}
+
+/*****************************/
+static int take_range(PoolQueue* q, int steal, const void* owner, PoolRange* r)
+{
+	/* Take the first range of the owner, looking from the end we take from */
+	/* Without an owner that is always the very first one */
+	pthread_mutex_lock(&q->lock);
+	int found = 0;
+
+	unsigned int i;
+	for(i = 0; i < q->back - q->front && !found; ++i)
+	{
+		unsigned int at = steal ? q->front + i : q->back-1 - i;
+		if(!is_owned(owner, q->ranges[at].job))
+			continue;
+
+		/* Close the gap it leaves behind */
+		*r = q->ranges[at];
+		found = 1;
+
+		if(steal)
+		{
+			for(; at > q->front; --at)
+				q->ranges[at] = q->ranges[at-1];
+			++q->front;
+		}
+		else
+		{
+			for(; at < q->back-1; ++at)
+				q->ranges[at] = q->ranges[at+1];
+			--q->back;
+		}
+	}
+
+	if(q->front == q->back)
+		q->front = q->back = 0;
+
+	pthread_mutex_unlock(&q->lock);
+	return found;
+}
+
+/*****************************/
+static int find_range(const void* owner, PoolRange* r)
+{
+	/* Own work first, most recently split so its data is still in cache */
+	if(pool.num_queues == 0)
+		return 0;
+	if(take_range(pool.queues + queue, 0, owner, r))
+		return 1;
+
+	/* Then steal from the others, starting at the next one so not all hit the same */
+	unsigned int t;
+	for(t = 1; t < pool.num_queues; ++t)
+		if(take_range(pool.queues + (queue + t) % pool.num_queues, 1, owner, r))
+			return 1;
+
+	return 0;
+}
+
+/*****************************/
+static void start_job(PoolJob* job, unsigned int count);
+
+/*****************************/
+static void finish_node(PoolGraphRun* g, PoolJob* job)
+{
+	unsigned int node = job - g->jobs;
+	unsigned int i;
+
+	/* Start every node that was only waiting for this one */
+	for(i = g->offsets[node]; i < g->offsets[node+1]; ++i)
+	{
+		unsigned int n = g->next[i];
+
+		pthread_mutex_lock(&pool.lock);
+		int ready = (--g->pending[n] == 0);
+		pthread_mutex_unlock(&pool.lock);
+
+		if(ready)
+			start_job(g->jobs + n, g->nodes[n].count);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	--g->remaining;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*****************************/
+static void finish_range(PoolJob* job, unsigned int count)
+{
+	/* The job cannot be touched once finished, whoever waits for it may return */
+	/* Unless it's a graph node, the graph is only done when all its nodes are */
+	PoolGraphRun* graph = job->graph;
+
+	pthread_mutex_lock(&pool.lock);
+	int finished = ((job->remaining -= count) == 0);
+	pthread_mutex_unlock(&pool.lock);
+
+	if(!finished)
+		return;
+
+	if(graph)
+		finish_node(graph, job);
+
+	signal_pool();
+}
+
+/*****************************/
+static void run_range(PoolRange* r)
+{
+	/* Split it in halves and queue the upper ones, until it's small enough */
+	/* If there is no room to queue, just run all of it */
+	PoolJob* job = r->job;
+	while(r->end - r->begin > job->grain)
+	{
+		unsigned int mid = r->begin + (r->end - r->begin) / 2;
+		if(!push_range(job, mid, r->end))
+			break;
+
+		r->end = mid;
+	}
+
+	if(job->range)
+		job->range(r->begin, r->end, job->data);
+	else
+	{
+		unsigned int i;
+		for(i = r->begin; i < r->end; ++i)
+			job->task(i, job->data);
+	}
+
+	finish_range(job, r->end - r->begin);
+}
+
+/*****************************/
+static void start_job(PoolJob* job, unsigned int count)
+{
+	job->remaining = count;
+
+	PoolRange r = { .job = job, .begin = 0, .end = count };
+	if(count == 0)
+		finish_range(job, 0);
+	else if(!push_range(job, 0, count))
+		run_range(&r);
+}
+
+/*****************************/
+static void wait_for(unsigned int* remaining, const void* owner)
+{
+	/* Help out until nothing remains, sleep if there's nothing to do */
+	/* The epoch tells if anything happened between looking and sleeping */
+	/* Threads outside the pool only help with what they wait for, i.e. the owner */
+	/* So e.g. the render thread never ends up running some patch's modifiers */
+	if(queue != 0)
+		owner = NULL;
+
+	for(;;)
+	{
+		pthread_mutex_lock(&pool.lock);
+		unsigned int epoch = pool.epoch;
+		int done = (*remaining == 0);
+		pthread_mutex_unlock(&pool.lock);
+
+		if(done)
+			return;
+
+		PoolRange r;
+		if(find_range(owner, &r))
+		{
+			run_range(&r);
+			continue;
+		}
+
+		pthread_mutex_lock(&pool.lock);
+		while(*remaining > 0 && pool.epoch == epoch)
+		{
+			++pool.sleeping;
+			pthread_cond_wait(&pool.wake, &pool.lock);
+			--pool.sleeping;
+		}
+		pthread_mutex_unlock(&pool.lock);
+	}
+}
+
+/*****************************/
+static void* worker(void* arg)
+{
+	queue = (unsigned int)(size_t)arg;
+
+	TRACE_THREAD("pool");
+
+	for(;;)
+	{
+		pthread_mutex_lock(&pool.lock);
+		unsigned int epoch = pool.epoch;
+		int quit = pool.quit;
+		pthread_mutex_unlock(&pool.lock);
+
+		if(quit)
+			break;
+
+		PoolRange r;
+		if(find_range(NULL, &r))
+		{
+			run_range(&r);
+			continue;
+		}
+
+		pthread_mutex_lock(&pool.lock);
+		while(!pool.quit && pool.epoch == epoch)
+		{
+			++pool.sleeping;
+			pthread_cond_wait(&pool.wake, &pool.lock);
+			--pool.sleeping;
+		}
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	return NULL;
+}
+
+/*****************************/
+static void create_pool(void)
+{
+	/* Get the number of threads, 0 means one per processor */
+	long threads = NUM_THREADS;
+	if(threads < 1)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(threads < 1)
+		threads = 1;
+
+	/* Count the threads locally, the pool only exists once num_threads is set */
+	unsigned int created = 1;
+	pool.quit = 0;
+
+	/* A queue per thread, without any all tasks run on the calling thread */
+	pool.queues = malloc(sizeof(PoolQueue) * threads);
+	pool.num_queues = 0;
+
+	while(pool.queues && pool.num_queues < (unsigned int)threads)
+	{
+		PoolQueue* q = pool.queues + pool.num_queues;
+		q->ranges = malloc(sizeof(PoolRange) * QUEUE_SIZE);
+		q->front = 0;
+		q->back = 0;
+		q->capacity = QUEUE_SIZE;
+
+		if(q->ranges == NULL)
+			break;
+
+		pthread_mutex_init(&q->lock, NULL);
+		++pool.num_queues;
+	}
+
+	if(pool.num_queues < (unsigned int)threads)
+	{
+		throw_error("Failed to allocate memory for a thread pool.");
+		threads = pool.num_queues ? pool.num_queues : 1;
+	}
+
+	/* The calling thread does its share, so spawn one less */
+	if(threads > 1)
+	{
+		pool.threads = malloc(sizeof(pthread_t) * (threads-1));
+		if(pool.threads == NULL)
+		{
+			throw_error("Failed to allocate memory for a thread pool.");
+			threads = 1;
+		}
+
+		while(created < (unsigned int)threads)
+		{
+			if(pthread_create(
+				pool.threads + (created-1), NULL, worker,
+				(void*)(size_t)created))
+			{
+				throw_error("Could only create %u threads for the thread pool.",
+					created);
+				break;
+			}
+
+			++created;
+		}
+	}
+
+	/* Publish it, everything above is visible to whoever reads the count */
+	__atomic_store_n(&pool.num_threads, created, __ATOMIC_RELEASE);
+	output("Thread pool running with %u threads.", created);
+}
+
+/*****************************/
+void pool_run(unsigned int count, PoolTask task, void* data)
+{
+	PoolJob job = {
+		.task  = task,
+		.range = NULL,
+		.data  = data,
+		.grain = 1,
+		.graph = NULL
+	};
+
+	/* No need to bother the pool for a single task */
+	if(pool_threads() == 1 || count <= 1)
+	{
+		unsigned int i;
+		for(i = 0; i < count; ++i)
+			task(i, data);
+
+		return;
+	}
+
+	start_job(&job, count);
+	wait_for(&job.remaining, &job);
+}
+
+/*****************************/
+void pool_for(unsigned int count, unsigned int grain, PoolRangeTask task, void* data)
+{
+	unsigned int threads = pool_threads();
+	if(grain == 0)
+		grain = (count + threads - 1) / threads;
+	if(grain == 0)
+		grain = 1;
+
+	PoolJob job = {
+		.task  = NULL,
+		.range = task,
+		.data  = data,
+		.grain = grain,
+		.graph = NULL
+	};
+
+	/* Without other threads, just run it in pieces of grain */
+	if(threads == 1 || count <= grain)
+	{
+		unsigned int i;
+		for(i = 0; i < count; i += grain)
+			task(i, (count - i < grain) ? count : i + grain, data);
+
+		return;
+	}
+
+	start_job(&job, count);
+	wait_for(&job.remaining, &job);
+}
+
+/*****************************/
+void pool_graph(unsigned int count, PoolNode* nodes)
+{
+	if(count == 0)
+		return;
+
+	/* Count the nodes depending on each node */
+	unsigned int n, d, deps = 0;
+	for(n = 0; n < count; ++n)
+		deps += nodes[n].num_deps;
+
+	PoolGraphRun g;
+	g.nodes = nodes;
+	g.jobs = malloc(sizeof(PoolJob) * count);
+	g.pending = malloc(sizeof(unsigned int) * count);
+	g.next = malloc(sizeof(unsigned int) * (deps + 1));
+	g.offsets = calloc(count + 1, sizeof(unsigned int));
+	g.remaining = count;
+
+	/* Without memory, run the nodes in an order that respects the dependencies */
+	/* A node is ready when all of its dependencies have run */
+	if(!g.jobs || !g.pending || !g.next || !g.offsets)
+	{
+		throw_error("Failed to allocate memory for a task graph, running it in order.");
+		free(g.jobs);
+		free(g.pending);
+		free(g.next);
+		free(g.offsets);
+
+		unsigned char run[count];
+		unsigned int left = count;
+		for(n = 0; n < count; ++n)
+			run[n] = 0;
+
+		while(left > 0)
+			for(n = 0; n < count; ++n)
+			{
+				int ready = !run[n];
+				for(d = 0; d < nodes[n].num_deps && ready; ++d)
+					ready = run[nodes[n].deps[d]];
+
+				if(ready)
+				{
+					pool_run(nodes[n].count, nodes[n].task, nodes[n].data);
+					run[n] = 1;
+					--left;
+				}
+			}
+
+		return;
+	}
+
+	/* Build the lists of nodes depending on each node */
+	for(n = 0; n < count; ++n)
+		for(d = 0; d < nodes[n].num_deps; ++d)
+			++g.offsets[nodes[n].deps[d] + 1];
+
+	for(n = 0; n < count; ++n)
+		g.offsets[n+1] += g.offsets[n];
+
+	unsigned int fill[count];
+	for(n = 0; n < count; ++n)
+		fill[n] = g.offsets[n];
+
+	for(n = 0; n < count; ++n)
+		for(d = 0; d < nodes[n].num_deps; ++d)
+			g.next[fill[nodes[n].deps[d]]++] = n;
+
+	/* Set up all jobs before starting any, as finished nodes start others */
+	for(n = 0; n < count; ++n)
+	{
+		g.jobs[n].task = nodes[n].task;
+		g.jobs[n].range = NULL;
+		g.jobs[n].data = nodes[n].data;
+		g.jobs[n].grain = 1;
+		g.jobs[n].graph = &g;
+		g.pending[n] = nodes[n].num_deps;
+	}
+
+	pool_threads();
+
+	/* Start all nodes without dependencies, the rest follows */
+	for(n = 0; n < count; ++n)
+		if(nodes[n].num_deps == 0)
+			start_job(g.jobs + n, nodes[n].count);
+
+	wait_for(&g.remaining, &g);
+
+	free(g.jobs);
+	free(g.pending);
+	free(g.next);
+	free(g.offsets);
+}
+
+/*****************************/
+static void free_scratch(void* mem)
+{
+	free(mem);
+}
+
+/*****************************/
+static void create_scratch(void)
+{
+	pthread_key_create(&scratch, free_scratch);
+}
+
+/*****************************/
+void* pool_scratch(size_t size)
+{
+	pthread_once(&scratch_once, create_scratch);
+
+	/* The memory is prefixed with its size */
+	size_t* mem = pthread_getspecific(scratch);
+	if(mem != NULL && mem[0] >= size)
+		return mem + 1;
+
+	free(mem);
+	mem = malloc(sizeof(size_t) + size);
+	pthread_setspecific(scratch, mem);
+
+	if(mem == NULL)
+	{
+		throw_error("Failed to allocate %zu bytes of scratch memory.", size);
+		return NULL;
+	}
+
+	mem[0] = size;
+	return mem + 1;
+}
+
+/*****************************/
+unsigned int pool_threads(void)
+{
+	/* The count only changes when creating or destroying the pool */
+	/* So once it is created, there is no need to lock */
+	unsigned int threads = __atomic_load_n(&pool.num_threads, __ATOMIC_ACQUIRE);
+	if(threads > 0)
+		return threads;
+
+	pthread_mutex_lock(&pool.create);
+	if(pool.num_threads == 0)
+		create_pool();
+
+	threads = pool.num_threads;
+	pthread_mutex_unlock(&pool.create);
+
+	return threads;
+}
+
+/*****************************/
+void destroy_pool(void)
+{
+	pthread_mutex_lock(&pool.create);
+
+	/* Tell all threads to quit and wait for them */
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+
+	unsigned int t;
+	for(t = 1; t < pool.num_threads; ++t)
+		pthread_join(pool.threads[t-1], NULL);
+
+	for(t = 0; t < pool.num_queues; ++t)
+	{
+		pthread_mutex_destroy(&pool.queues[t].lock);
+		free(pool.queues[t].ranges);
+	}
+
+	free(pool.threads);
+	free(pool.queues);
+	pool.threads = NULL;
+	pool.queues = NULL;
+	pool.num_queues = 0;
+	__atomic_store_n(&pool.num_threads, 0, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&pool.create);
+}
@@ -4,10 +4,21 @@
 #include "generators.h"
 #include "modifiers.h"
 #include "output.h"
+#include "pool.h"
 #include "scene.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 
+/* Vertices of fresh patches being built, see update_scene */
+typedef struct
+{
+	ScenePatch** patches;
+	float*       vertices; /* Vertices of each patch, one after the other */
+
+} SceneBuild;
+
+
 /*****************************/
 static unsigned int get_min_grid_size(int x, int y)
 {
@@ -37,6 +48,17 @@ static size_t get_grid_index(unsigned int gridSize, int x, int y)
 	return (x * gridSize + y) * 4 + quadrant;
 }
 
+/*****************************/
+static void build_patch(unsigned int i, void* data)
+{
+	/* Build into the i-th part of the buffer */
+	SceneBuild* build = data;
+	ScenePatch* s = build->patches[i];
+	size_t n = (size_t)s->mesh.size * s->mesh.size * 9;
+
+	build_snapshot_vertices(s->mesh.size, &s->patch.front, build->vertices + n * i);
+}
+
 /*****************************/
 static int add_patch(
 	Scene*         scene,
@@ -54,7 +76,7 @@ static int add_patch(
 		/* Allocate more memory, multiply by 4 for all quadrants */
 		/* Again, interlaced data array :) */
 		size_t newSize = minGridSize * minGridSize * 4;
-		Patch* new = realloc(scene->patches, newSize * sizeof(Patch));
+		ScenePatch** new = realloc(scene->patches, newSize * sizeof(ScenePatch*));
 
 		if(!new)
 		{
@@ -62,9 +84,9 @@ static int add_patch(
 			return 0;
 		}
 
-		/* Set memory to zero for the newly allocated spots so is_patch returns 0 */
+		/* Set the newly allocated spots to NULL, i.e. no patch */
 		size_t oldSize = scene->grid_size * scene->grid_size * 4;
-		memset(new + oldSize, 0, (newSize - oldSize) * sizeof(Patch));
+		memset(new + oldSize, 0, (newSize - oldSize) * sizeof(ScenePatch*));
 
 		if(scene->grid_size)
 		{
@@ -77,11 +99,11 @@ static int add_patch(
 				{
 					/* Move to the new location and set the old one to 0's */
 					/* Just copy all quadrants together btw */
-					Patch* p = new + get_grid_index(scene->grid_size, ix, iy-1);
-					Patch* np = new + get_grid_index(minGridSize, ix, iy-1);
+					ScenePatch** p = new + get_grid_index(scene->grid_size, ix, iy-1);
+					ScenePatch** np = new + get_grid_index(minGridSize, ix, iy-1);
 
-					memcpy(np, p, sizeof(Patch) * 4);
-					memset(p, 0, sizeof(Patch) * 4);
+					memcpy(np, p, sizeof(ScenePatch*) * 4);
+					memset(p, 0, sizeof(ScenePatch*) * 4);
 				}
 		}
 
@@ -90,22 +112,45 @@ static int add_patch(
 	}
 
 	/* Get the index of the new patch */
-	Patch* p = scene->patches + get_grid_index(scene->grid_size, x, y);
+	ScenePatch** sp = scene->patches + get_grid_index(scene->grid_size, x, y);
 
 	/* Check if there was already a patch */
-	if(is_patch(p))
+	if(*sp != NULL)
 	{
 		output("Patch cannot be placed on top of another patch.");
 		return 0;
 	}
 
-	/* Create a new patch */
-	if(!create_patch(p, scene->patch_mode, scene->patch_size))
+	/* Create a new patch and its mesh */
+	ScenePatch* s = malloc(sizeof(ScenePatch));
+	if(s == NULL)
+	{
+		throw_error("Could not allocate memory for a new patch.");
+		return 0;
+	}
+
+	s->fresh = 0;
+
+	Patch* p = &s->patch;
+	if(!create_patch(p, scene->patch_mode, scene->patch_accel, scene->patch_size))
 	{
 		throw_error("Could not create a new patch for scene.");
+		free(s);
+		return 0;
+	}
+
+	p->batch = &scene->batch;
+
+	if(!create_mesh(&s->mesh, scene->patch_size))
+	{
+		throw_error("Could not create a mesh for a new patch.");
+		destroy_patch(p);
+		free(s);
 		return 0;
 	}
 
+	*sp = s;
+
 	/* Set its position to the current selection */
 	p->pos[0] = x * (DEF_PATCH_SIZE-1);
 	p->pos[1] = y * (DEF_PATCH_SIZE-1);
@@ -121,17 +166,20 @@ static int add_patch(
 		for(r = -1; r <= 1; ++r)
 		{
 			unsigned int i = get_grid_index(scene->grid_size, x + c, y + r);
-			Patch* pn = scene->patches + i;
 
-			if(i < scene->grid_size * scene->grid_size * 4)
-				if(is_patch(pn)) local[(c+1)*3+(r+1)] = pn;
+			if(i < scene->grid_size * scene->grid_size * 4 && scene->patches[i])
+				local[(c+1)*3+(r+1)] = &scene->patches[i]->patch;
 		}
 
-	/* Populate the new patch */
-	if(!populate_patch(p, generator, mods, outs, local))
+	/* Populate the new patch and upload what it starts off with */
+	if(!populate_patch(p, generator, mods, outs, local) ||
+		!upload_mesh(&s->mesh, &p->front))
 	{
 		throw_error("Population of newly created patch failed.");
+		destroy_mesh(&s->mesh);
 		destroy_patch(p);
+		free(s);
+		*sp = NULL;
 		return 0;
 	}
 
@@ -194,11 +242,12 @@ static void update_camera(Scene* scene, double dTime)
 }
 
 /*****************************/
-int create_scene(Scene* scene, ModMode mode, unsigned int patchSize)
+int create_scene(Scene* scene, ModMode mode, Accel accel, unsigned int patchSize)
 {
 	if(patchSize < 2) patchSize = DEF_PATCH_SIZE;
 	scene->patch_size = patchSize;
 	scene->patch_mode = mode;
+	scene->patch_accel = accel;
 
 	/* Load shaders */
 	if(!create_shader(&scene->patch_shader, PATCH_VERT, PATCH_FRAG))
@@ -214,6 +263,15 @@ int create_scene(Scene* scene, ModMode mode, unsigned int patchSize)
 		return 0;
 	}
 
+	/* All patches relax together, as one job on the thread pool */
+	if(!create_patch_batch(&scene->batch))
+	{
+		throw_error("Could not create a batch for patches in scene.");
+		destroy_shader(&scene->patch_shader);
+		destroy_shader(&scene->help_shader);
+		return 0;
+	}
+
 	/* Setup camera */
 	/* The update_camera takes care of the view and pv matrices */
 	memset(scene->cam_dest, 0, sizeof(scene->cam_dest));
@@ -279,10 +337,15 @@ void destroy_scene(Scene* scene)
 	/* Loop over all patches to destroy them */
 	size_t p;
 	for(p = 0; p < scene->grid_size * scene->grid_size * 4; ++p)
-		if(is_patch(scene->patches + p))
-			destroy_patch(scene->patches + p);
+		if(scene->patches[p] != NULL)
+		{
+			destroy_mesh(&scene->patches[p]->mesh);
+			destroy_patch(&scene->patches[p]->patch);
+			free(scene->patches[p]);
+		}
 
 	free(scene->patches);
+	destroy_patch_batch(&scene->batch);
 }
 
 /*****************************/
@@ -301,7 +364,7 @@ int scene_add_patch(Scene* scene)
 		mod_output_flags,
 		mod_output_constrs,
 		mod_stats,
-		mod_relax,
+		scene->patch_mode == MULTIGRID ? mod_relax_multigrid : mod_relax,
 		mod_output,
 		mod_stats,
 		NULL
@@ -353,6 +416,7 @@ int scene_add_patch(Scene* scene)
 void draw_scene(Scene* scene)
 {
 	/* Setup patch shader */
+	TRACE_BEGIN(draw);
 	glEnable(GL_DEPTH_TEST);
 	glUseProgram(scene->patch_shader.program);
 	GLint loc = glGetUniformLocation(scene->patch_shader.program, "MVP");
@@ -366,18 +430,18 @@ void draw_scene(Scene* scene)
 	size_t p;
 	for(p = 0; p < scene->grid_size * scene->grid_size * 4; ++p)
 	{
-		if(!is_patch(scene->patches + p))
+		if(scene->patches[p] == NULL)
 			continue;
 
 		/* The height (z-coord) of all patches is roughly in [0,1] */
 		/* So move it down 0.5 and scale it */
-		glm_translate_to(scene->camera.pv, scene->patches[p].pos, mvp);
+		glm_translate_to(scene->camera.pv, scene->patches[p]->patch.pos, mvp);
 		glm_scale(mvp, scale);
 		glm_translate_z(mvp, -.5f);
 		glUniformMatrix4fv(loc, 1, GL_FALSE, (float*)mvp);
 
 		/* Draw it, this assumes the above work is done, which it is :) */
-		draw_patch(scene->patches + p);
+		draw_mesh(&scene->patches[p]->mesh);
 	}
 
 	/* Setup helper geometry shader */
@@ -397,6 +461,8 @@ void draw_scene(Scene* scene)
 	glBindVertexArray(scene->help_vao);
 	glDrawArrays(GL_LINE_LOOP, 0, 4);
 	glDrawArrays(GL_LINES, 4, 6);
+
+	TRACE_END(draw, "draw_scene");
 }
 
 /*****************************/
@@ -413,10 +479,44 @@ void update_scene(Scene* scene, double dTime)
 	}
 
 	/* Loop over all patches to update them */
+	/* Their modifiers run in the background, this only uploads what they did */
 	size_t p;
+	unsigned int count = 0;
 	for(p = 0; p < scene->grid_size * scene->grid_size * 4; ++p)
-		if(is_patch(scene->patches + p))
-			update_patch(scene->patches + p);
+	{
+		ScenePatch* s = scene->patches[p];
+		if(s == NULL)
+			continue;
+
+		update_patch(&s->patch, &s->fresh);
+		count += s->fresh ? 1 : 0;
+	}
+
+	if(count == 0)
+		return;
+
+	/* Build the vertices of all fresh patches at once, only uploading is left to us */
+	/* All patches are the same size, the list of patches is followed by their vertices */
+	size_t n = (size_t)scene->patch_size * scene->patch_size * 9;
+	SceneBuild build;
+	build.patches = pool_scratch((sizeof(ScenePatch*) + sizeof(float) * n) * count);
+
+	if(build.patches == NULL)
+	{
+		throw_error("Failed to allocate memory to generate vertices.");
+		return;
+	}
+
+	build.vertices = (float*)(build.patches + count);
+	unsigned int i = 0;
+	for(p = 0; p < scene->grid_size * scene->grid_size * 4; ++p)
+		if(scene->patches[p] != NULL && scene->patches[p]->fresh)
+			build.patches[i++] = scene->patches[p];
+
+	pool_run(count, build_patch, &build);
+
+	for(i = 0; i < count; ++i)
+		upload_mesh_vertices(&build.patches[i]->mesh, build.vertices + n * i);
 }
 
 /*****************************/
@@ -425,7 +525,8 @@ int is_scene_done(Scene* scene)
 	int done = 1;
 	size_t p;
 	for(p = 0; p < scene->grid_size * scene->grid_size * 4; ++p)
-		done &= is_patch_done(scene->patches + p);
+		if(scene->patches[p] != NULL)
+			done &= is_patch_done(&scene->patches[p]->patch);
 
 	return done;
 }
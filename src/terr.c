@@ -0,0 +1,210 @@
+#include "constants.h"
+#include "generators.h"
+#include "modifiers.h"
+#include "output.h"
+#include "patch.h"
+#include "terr.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Patch definition, a lot simpler than a Patch as nothing runs in the background */
+struct TerrPatch
+{
+	unsigned int size;
+	Vertices     data;
+	ModData*     mods;
+	size_t       num_mods;
+	ModMode      mode;
+	Accel        accel;
+};
+
+
+/*****************************/
+static void reset_mod(ModData* mod)
+{
+	free(mod->buffer);
+	free(mod->work);
+
+	mod->done       = 0;
+	mod->converged  = 0;
+	mod->iterations = 0;
+	mod->steps      = 0;
+	mod->cost       = 0;
+	mod->time       = 0;
+	mod->buffer     = NULL;
+	mod->work       = NULL;
+}
+
+/*****************************/
+TerrPatch* terr_create(unsigned int size, const char* mode)
+{
+	if(size < 2)
+	{
+		throw_error("A patch must be at least 2 vertices wide.");
+		return NULL;
+	}
+
+	TerrPatch* patch = malloc(sizeof(TerrPatch));
+	if(patch == NULL)
+	{
+		throw_error("Failed to allocate memory for a patch.");
+		return NULL;
+	}
+
+	if(!create_vertices(&patch->data, size))
+	{
+		throw_error("Failed to allocate memory for a patch.");
+		free(patch);
+		return NULL;
+	}
+
+	patch->size = size;
+	patch->mods = NULL;
+	patch->num_mods = 0;
+	patch->mode = SEQUENTIAL;
+	read_mode(mode ? mode : "s", &patch->mode, &patch->accel);
+
+	return patch;
+}
+
+/*****************************/
+void terr_destroy(TerrPatch* patch)
+{
+	if(patch == NULL)
+		return;
+
+	size_t m;
+	for(m = 0; m < patch->num_mods; ++m)
+		reset_mod(patch->mods + m);
+
+	free(patch->mods);
+	destroy_vertices(&patch->data);
+	free(patch);
+}
+
+/*****************************/
+int terr_generate(TerrPatch* patch, unsigned int seed)
+{
+	/* Start from scratch, flags and all */
+	size_t n = (size_t)patch->size * patch->size;
+	memset(patch->data.h, 0, (sizeof(float) * 4 + sizeof(unsigned char)) * n);
+
+	size_t m;
+	for(m = 0; m < patch->num_mods; ++m)
+		reset_mod(patch->mods + m);
+
+	srand(seed);
+	return gen_mpd(patch->size, &patch->data);
+}
+
+/*****************************/
+int terr_add_modifier(TerrPatch* patch, TerrModifier mod, const char* out)
+{
+	PatchModifier func =
+		mod == TERR_SUBDIVIDE ? mod_subdivide :
+		mod == TERR_RELAX ?
+			(patch->mode == MULTIGRID ? mod_relax_multigrid : mod_relax) :
+		mod == TERR_STATS ? mod_stats :
+		mod == TERR_OUTPUT ? mod_output :
+		NULL;
+
+	if(func == NULL)
+	{
+		throw_error("Unknown modifier: %i", (int)mod);
+		return 0;
+	}
+
+	ModData* mods = realloc(patch->mods, sizeof(ModData) * (patch->num_mods + 1));
+	if(mods == NULL)
+	{
+		throw_error("Could not allocate memory for new modifier data.");
+		return 0;
+	}
+
+	/* No neighbourhood, so its borders are free */
+	ModData* data = mods + patch->num_mods;
+	memset(data, 0, sizeof(ModData));
+	data->mod   = func;
+	data->out   = out;
+	data->mode  = patch->mode;
+	data->accel = patch->accel;
+
+	patch->mods = mods;
+	++patch->num_mods;
+
+	return 1;
+}
+
+/*****************************/
+int terr_run(TerrPatch* patch, unsigned int iterations)
+{
+	/* Run the modifiers in order, like a patch's worker would */
+	/* If until done, use big steps, nobody is waiting for snapshots */
+	unsigned int left = iterations;
+
+	size_t m = 0;
+	while(m < patch->num_mods && (iterations == 0 || left > 0))
+	{
+		ModData* data = patch->mods + m;
+		if(data->done)
+		{
+			++m;
+			continue;
+		}
+
+		data->steps = (iterations == 0 || left > MAX_STEP_SIZE) ? MAX_STEP_SIZE : left;
+		unsigned int start = data->iterations;
+
+		PatchModifier mod = (PatchModifier)data->mod;
+		if(!mod(patch->size, &patch->data, data))
+		{
+			throw_error("Could not update patch due to faulty modifier.");
+			return 0;
+		}
+
+		unsigned int done = data->iterations - start;
+		left -= (done < left) ? done : left;
+	}
+
+	return 1;
+}
+
+/*****************************/
+int terr_is_done(TerrPatch* patch)
+{
+	int done = 1;
+	size_t m;
+	for(m = 0; m < patch->num_mods; ++m)
+		done &= patch->mods[m].done;
+
+	return done;
+}
+
+/*****************************/
+unsigned int terr_get_iterations(TerrPatch* patch)
+{
+	unsigned int iterations = 0;
+	size_t m;
+	for(m = 0; m < patch->num_mods; ++m)
+		iterations += patch->mods[m].iterations;
+
+	return iterations;
+}
+
+/*****************************/
+unsigned int terr_get_size(TerrPatch* patch)
+{
+	return patch->size;
+}
+
+/*****************************/
+void terr_get_heights(TerrPatch* patch, float* out)
+{
+	memcpy(out, patch->data.h, sizeof(float) * patch->size * patch->size);
+}
+
+/*****************************/
+void terr_get_flags(TerrPatch* patch, unsigned char* out)
+{
+	memcpy(out, patch->data.flags, sizeof(unsigned char) * patch->size * patch->size);
+}
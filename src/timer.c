@@ -0,0 +1,14 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "timer.h"
+#include <time.h>
+
+/*****************************/
+double get_time(void)
+{
+	/* Monotonic, so it never jumps when the system clock is adjusted */
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
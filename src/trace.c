@@ -0,0 +1,151 @@
+#include "output.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Maximum length of a track name */
+#define TRACK_NAME_SIZE 32
+
+
+/* A single complete event */
+typedef struct
+{
+	const char*  name;
+	unsigned int track;
+	double       start;
+	double       end;
+
+} TraceEvent;
+
+
+/* A named track */
+typedef struct
+{
+	char name[TRACK_NAME_SIZE];
+
+} TraceTrack;
+
+
+/* All recorded events, shared by all threads */
+static struct
+{
+	pthread_mutex_t lock;
+	TraceEvent*     events;
+	size_t          count;
+	size_t          capacity;
+	TraceTrack*     tracks;
+	unsigned int    num_tracks;
+	double          origin; /* Time of the first event, or earlier */
+
+} trace = {
+	.lock       = PTHREAD_MUTEX_INITIALIZER,
+	.events     = NULL,
+	.count      = 0,
+	.capacity   = 0,
+	.tracks     = NULL,
+	.num_tracks = 0,
+	.origin     = -1
+};
+
+/* Track of the current thread, 0 is the main thread's */
+static __thread unsigned int track = 0;
+
+
+/*****************************/
+void add_trace(const char* name, double start, double end)
+{
+	pthread_mutex_lock(&trace.lock);
+
+	/* Grow by doubling, events are never removed until written */
+	if(trace.count == trace.capacity)
+	{
+		size_t capacity = trace.capacity ? trace.capacity * 2 : 1024;
+		TraceEvent* events = realloc(trace.events, sizeof(TraceEvent) * capacity);
+
+		if(events == NULL)
+		{
+			pthread_mutex_unlock(&trace.lock);
+			return;
+		}
+
+		trace.events = events;
+		trace.capacity = capacity;
+	}
+
+	TraceEvent* e = trace.events + trace.count++;
+	e->name = name;
+	e->track = track;
+	e->start = start;
+	e->end = end;
+
+	if(trace.origin < 0 || start < trace.origin)
+		trace.origin = start;
+
+	pthread_mutex_unlock(&trace.lock);
+}
+
+/*****************************/
+void begin_trace_thread(const char* name)
+{
+	pthread_mutex_lock(&trace.lock);
+
+	/* Track 0 is always the main thread */
+	if(trace.num_tracks == 0)
+		trace.num_tracks = 1;
+
+	TraceTrack* tracks = realloc(trace.tracks, sizeof(TraceTrack) * (trace.num_tracks + 1));
+	if(tracks != NULL)
+	{
+		trace.tracks = tracks;
+		track = trace.num_tracks++;
+		snprintf(tracks[track].name, TRACK_NAME_SIZE, "%s %u", name, track);
+	}
+
+	pthread_mutex_unlock(&trace.lock);
+}
+
+/*****************************/
+int write_trace(const char* file)
+{
+	FILE* f = fopen(file, "w");
+	if(f == NULL)
+	{
+		throw_error("Could not open file: %s", file);
+		return 0;
+	}
+
+	pthread_mutex_lock(&trace.lock);
+
+	/* The JSON array format, timestamps are in microseconds */
+	fputs("[\n\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+		"\"args\": { \"name\": \"main\" } }", f);
+
+	unsigned int t;
+	for(t = 1; t < trace.num_tracks; ++t)
+		fprintf(f,
+			",\n\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+			"\"args\": { \"name\": \"%s\" } }",
+			t, trace.tracks[t].name);
+
+	size_t i;
+	for(i = 0; i < trace.count; ++i)
+	{
+		TraceEvent* e = trace.events + i;
+		fprintf(f,
+			",\n\t{ \"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+			"\"ts\": %.3f, \"dur\": %.3f }",
+			e->name, e->track,
+			(e->start - trace.origin) * 1e6, (e->end - e->start) * 1e6);
+	}
+
+	fputs("\n]\n", f);
+	fclose(f);
+
+	trace.count = 0;
+	pthread_mutex_unlock(&trace.lock);
+
+	output("Trace has been written to file: %s", file);
+
+	return 1;
+}
@@ -0,0 +1,272 @@
+#include "constants.h"
+#include "generators.h"
+#include "modifiers.h"
+#include "output.h"
+#include "patch.h"
+#include "pool.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum number of sizes to run in one go */
+#define MAX_SIZES  16
+
+
+/* A solver to compare, i.e. a calculation mode */
+typedef struct
+{
+	const char* name;
+	ModMode     mode;
+	Accel       accel;
+
+} Solver;
+
+
+/* Result of running a solver on a terrain */
+typedef struct
+{
+	Vertices     data;
+	Stats        stats;
+	unsigned int iterations;
+	int          converged;
+	float        moved; /* Mean height change, i.e. material moved */
+
+} Solution;
+
+
+/*****************************/
+static int solve(unsigned int size, Vertices* src, Solver* solver, Solution* sol)
+{
+	/* Start from the same subdivided terrain, relax it until done */
+	if(!create_vertices(&sol->data, size))
+	{
+		throw_error("Failed to allocate memory for a %u^2 patch.", size);
+		return 0;
+	}
+
+	memcpy(sol->data.h, src->h, (sizeof(float) * 4 + sizeof(unsigned char)) * size * size);
+
+	PatchModifier relax = (solver->mode == MULTIGRID) ? mod_relax_multigrid : mod_relax;
+	ModData mod;
+	memset(&mod, 0, sizeof(ModData));
+	mod.mode = solver->mode;
+	mod.accel = solver->accel;
+	mod.steps = MAX_STEP_SIZE;
+
+	while(!mod.done)
+		if(!relax(size, &sol->data, &mod))
+		{
+			free(mod.buffer);
+			free(mod.work);
+			destroy_vertices(&sol->data);
+			return 0;
+		}
+
+	calc_stats(size, &sol->data, &sol->stats);
+	sol->iterations = mod.iterations;
+	sol->converged = mod.converged;
+
+	/* Summed as doubles, the changes are tiny compared to the heights */
+	double moved = 0;
+	unsigned int i;
+	for(i = 0; i < size * size; ++i)
+		moved += fabsf(sol->data.h[i] - src->h[i]);
+
+	sol->moved = moved / (size * size);
+
+	return 1;
+}
+
+/*****************************/
+static int compare_constraints(
+	const char*      name,
+	ConstraintStats* ref,
+	ConstraintStats* cand)
+{
+	/* The same constraints, and no more of them may be unsatisfied */
+	if(ref->count != cand->count)
+	{
+		output("  FAIL %s: %u constraints instead of %u", name, cand->count, ref->count);
+		return 0;
+	}
+
+	if(cand->unsatisfied > ref->unsatisfied)
+	{
+		output("  FAIL %s: %u unsatisfied instead of %u",
+			name, cand->unsatisfied, ref->unsatisfied);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*****************************/
+static int compare(
+	unsigned int size,
+	Solution*    ref,
+	Solution*    cand,
+	float        tolerance)
+{
+	int pass = 1;
+
+	/* Heights, the largest difference of any vertex */
+	float diff = 0;
+	unsigned int i;
+	for(i = 0; i < size * size; ++i)
+		diff = fmaxf(diff, fabsf(ref->data.h[i] - cand->data.h[i]));
+
+	if(!(diff <= tolerance))
+	{
+		output("  FAIL heights: max difference %g > %g", diff, tolerance);
+		pass = 0;
+	}
+
+	/* Relaxation moves heights around, it should never add or remove any */
+	float supplies = fabsf(ref->stats.supplies - cand->stats.supplies) /
+		fmaxf(fabsf(ref->stats.supplies), FLT_MIN);
+
+	if(!(supplies <= VERIFY_SUPPLIES))
+	{
+		output("  FAIL supplies: %f instead of %f", cand->stats.supplies, ref->stats.supplies);
+		pass = 0;
+	}
+
+	/* The EMD needs EMD.py, but the material moved is as telling */
+	/* A candidate that settles further away than the reference moves more */
+	if(!(cand->moved <= ref->moved * (1 + VERIFY_MOVED)))
+	{
+		output("  FAIL moved: %f instead of %f", cand->moved, ref->moved);
+		pass = 0;
+	}
+
+	pass &= compare_constraints("slope", &ref->stats.slope, &cand->stats.slope);
+	pass &= compare_constraints("directional", &ref->stats.dir_slope, &cand->stats.dir_slope);
+	pass &= compare_constraints("roughness", &ref->stats.roughness, &cand->stats.roughness);
+	pass &= compare_constraints("position", &ref->stats.position, &cand->stats.position);
+
+	/* Iteration counts are allowed to differ, that's the point of most variants */
+	/* But if the reference converges, so must the candidate */
+	if(ref->converged && !cand->converged)
+	{
+		output("  FAIL iterations: did not converge in %u", cand->iterations);
+		pass = 0;
+	}
+
+	output("%s %4u^2  max height difference %g, moved %.2fx, iterations %u vs %u (%.2fx)",
+		pass ? "PASS" : "FAIL", size, diff,
+		(double)cand->moved / fmaxf(ref->moved, FLT_MIN),
+		cand->iterations, ref->iterations,
+		(double)cand->iterations / (ref->iterations ? ref->iterations : 1));
+
+	return pass;
+}
+
+/*****************************/
+static int verify(
+	unsigned int size,
+	unsigned int seed,
+	Solver*      ref,
+	Solver*      cand,
+	float        tolerance)
+{
+	/* Generate and subdivide, exactly as terr does for this seed */
+	Vertices src;
+	if(!create_vertices(&src, size))
+	{
+		throw_error("Failed to allocate memory for a %u^2 patch.", size);
+		return 0;
+	}
+
+	ModData mod;
+	memset(&mod, 0, sizeof(ModData));
+
+	srand(seed);
+	if(!gen_mpd(size, &src) || !mod_subdivide(size, &src, &mod))
+	{
+		destroy_vertices(&src);
+		return 0;
+	}
+
+	Solution rs, cs;
+	int pass = 0;
+
+	if(solve(size, &src, ref, &rs))
+	{
+		if(solve(size, &src, cand, &cs))
+		{
+			output("Seed %u, %s against %s:", seed, cand->name, ref->name);
+			pass = compare(size, &rs, &cs, tolerance);
+			destroy_vertices(&cs.data);
+		}
+
+		destroy_vertices(&rs.data);
+	}
+
+	destroy_vertices(&src);
+
+	return pass;
+}
+
+/*****************************/
+int main(int argc, char* argv[])
+{
+	/* Input is similar to terr_batch */
+	/* - First argument is a comma separated list of grid sizes, e.g. 65,129 */
+	/* - Second argument is the mode of the reference solver, as for terr */
+	/* - Third argument is the mode of the candidate solver */
+	/* - Fourth argument is a range of seeds, e.g. 1-100, or a single one */
+	/* - Fifth argument is the maximum height difference, default VERIFY_HEIGHT */
+	if(argc < 5)
+	{
+		throw_error("Usage: terr_verify <resolutions> <reference> <candidate> <seeds> <tolerance>");
+		return EXIT_FAILURE;
+	}
+
+	unsigned int sizes[MAX_SIZES];
+	unsigned int numSizes = 0;
+
+	char* str = argv[1];
+	while(*str != '\0' && numSizes < MAX_SIZES)
+	{
+		sizes[numSizes] = strtoul(str, &str, 10);
+		if(sizes[numSizes] >= 2)
+			++numSizes;
+		if(*str == ',')
+			++str;
+		else
+			break;
+	}
+
+	Solver ref = { .name = argv[2], .mode = SEQUENTIAL };
+	Solver cand = { .name = argv[3], .mode = SEQUENTIAL };
+	read_mode(argv[2], &ref.mode, &ref.accel);
+	read_mode(argv[3], &cand.mode, &cand.accel);
+
+	unsigned int first = strtoul(argv[4], &str, 10);
+	unsigned int last = (*str == '-') ? strtoul(str + 1, NULL, 10) : first;
+
+	float tolerance = (argc > 5) ? strtof(argv[5], NULL) : VERIFY_HEIGHT;
+
+	if(numSizes == 0 || first < 1 || last < first)
+	{
+		throw_error("Invalid resolutions or seeds, seeds must be > 0.");
+		return EXIT_FAILURE;
+	}
+
+	/* Run all of them, even if one fails, so the report is complete */
+	unsigned int count = 0, passed = 0;
+	unsigned int s, seed;
+	for(s = 0; s < numSizes; ++s)
+		for(seed = first; seed <= last; ++seed)
+		{
+			passed += verify(sizes[s], seed, &ref, &cand, tolerance);
+			++count;
+		}
+
+	output("");
+	output("%s: %u of %u passed.", passed == count ? "PASS" : "FAIL", passed, count);
+	destroy_pool();
+
+	return passed == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+import ctypes
+import os
+
+# Library to load, build it with make libterr
+LIB_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libterr.so')
+
+# Modifiers, as in terr.h
+SUBDIVIDE = 0
+RELAX     = 1
+STATS     = 2
+OUTPUT    = 3
+
+
+#######################
+# Loads the library and declares its functions
+def load(path=LIB_FILE):
+    lib = ctypes.CDLL(path)
+    p = ctypes.c_void_p
+
+    lib.terr_create.restype = p
+    lib.terr_create.argtypes = [ctypes.c_uint, ctypes.c_char_p]
+    lib.terr_destroy.argtypes = [p]
+    lib.terr_generate.argtypes = [p, ctypes.c_uint]
+    lib.terr_add_modifier.argtypes = [p, ctypes.c_int, ctypes.c_char_p]
+    lib.terr_run.argtypes = [p, ctypes.c_uint]
+    lib.terr_is_done.argtypes = [p]
+    lib.terr_get_iterations.restype = ctypes.c_uint
+    lib.terr_get_iterations.argtypes = [p]
+    lib.terr_get_size.restype = ctypes.c_uint
+    lib.terr_get_size.argtypes = [p]
+    lib.terr_get_heights.argtypes = [p, ctypes.POINTER(ctypes.c_float)]
+    lib.terr_get_flags.argtypes = [p, ctypes.POINTER(ctypes.c_ubyte)]
+
+    return lib
+
+
+#######################
+# A single patch, the same calculation terr does, without the window
+# Modifier output files are kept alive here, the library only borrows them
+class Patch:
+    def __init__(self, size, mode='s', lib=None):
+        self.lib = lib if lib else load()
+        self.outs = []
+        self.ptr = self.lib.terr_create(size, mode.encode())
+        if not self.ptr:
+            raise RuntimeError('Could not create a patch of size {}'.format(size))
+
+    def __del__(self):
+        if getattr(self, 'ptr', None):
+            self.lib.terr_destroy(self.ptr)
+            self.ptr = None
+
+    def generate(self, seed):
+        if not self.lib.terr_generate(self.ptr, seed):
+            raise RuntimeError('Could not generate a patch')
+
+    def add(self, mod, out=None):
+        out = out.encode() if out else None
+        self.outs.append(out)
+        if not self.lib.terr_add_modifier(self.ptr, mod, out):
+            raise RuntimeError('Could not add modifier {}'.format(mod))
+
+    # Runs at most N iterations, or until done if N is 0
+    def run(self, N=0):
+        if not self.lib.terr_run(self.ptr, N):
+            raise RuntimeError('A modifier failed')
+        return self.done()
+
+    def done(self):
+        return self.lib.terr_is_done(self.ptr) != 0
+
+    def iterations(self):
+        return self.lib.terr_get_iterations(self.ptr)
+
+    # Column-major, i.e. heights()[c * size + r]
+    def heights(self):
+        n = self.lib.terr_get_size(self.ptr)
+        out = (ctypes.c_float * (n * n))()
+        self.lib.terr_get_heights(self.ptr, out)
+        return list(out)
+
+    def flags(self):
+        n = self.lib.terr_get_size(self.ptr)
+        out = (ctypes.c_ubyte * (n * n))()
+        self.lib.terr_get_flags(self.ptr, out)
+        return list(out)